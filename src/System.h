@@ -78,6 +78,10 @@ extern bool systemCanChangeSoundQuality();
 extern void systemShowSpeed(int);
 extern void system10Frames(int);
 extern void systemFrame();
+#ifdef __LIBRETRO__
+// colors is the line as handed to the color map, before it is drawn to pix
+extern void systemLineDrawn(int line, const void *colors, int size);
+#endif
 extern void systemGbBorderOn();
 extern void Sm60FPS_Init();
 extern bool Sm60FPS_CanSkipFrame();
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #ifndef _WIN32
 #include <sys/stat.h>
@@ -28,6 +30,7 @@ extern "C" {
 #include "NLS.h"
 #include "System.h"
 #include "Util.h"
+#include "common/ArchiveIndex.h"
 #include "common/Port.h"
 #include "gba/Flash.h"
 #include "gba/GBA.h"
@@ -228,11 +231,10 @@ void utilReadScreenPixels(uint8_t *dest, int w, int h)
 
 #define CHANNEL_NUM 3 // RGB
 
-bool utilWritePNGFile(const char *fileName, int w, int h, uint8_t *pix)
+// convert the emulator's frame buffer to top-down RGB, w * h * 3 bytes
+void utilPixToRGB(uint8_t *pix, int w, int h, uint8_t *dest)
 {
-        uint8_t *writeBuffer = new uint8_t[w * h * CHANNEL_NUM];
-
-        uint8_t *b = writeBuffer;
+        uint8_t *b = dest;
 
         int sizeX = w;
         int sizeY = h;
@@ -287,12 +289,35 @@ bool utilWritePNGFile(const char *fileName, int w, int h, uint8_t *pix)
                     }
             } break;
         }
+}
 
-        bool ret = (0 != stbi_write_png(fileName, w, h, CHANNEL_NUM, writeBuffer, w * CHANNEL_NUM));
+bool utilWritePNGFile(const char *fileName, int w, int h, uint8_t *pix)
+{
+        uint8_t *writeBuffer = new uint8_t[w * h * CHANNEL_NUM];
+
+        utilPixToRGB(pix, w, h, writeBuffer);
+
+        bool ret = utilWriteRGBPNGFile(fileName, w, h, writeBuffer, -1);
         delete[] writeBuffer;
         return ret;
 }
 
+// guards stbi_write_png_compression_level, which is global; the
+// ScreenshotWriter thread writes PNGs while the emulator thread may too
+static std::mutex pngLock;
+
+// level is the zlib compression level, or -1 for the default
+bool utilWriteRGBPNGFile(const char *fileName, int w, int h, const uint8_t *rgb, int level)
+{
+        std::lock_guard<std::mutex> guard(pngLock);
+
+        if (level >= 0)
+                stbi_write_png_compression_level = level;
+        bool ret = (0 != stbi_write_png(fileName, w, h, CHANNEL_NUM, rgb, w * CHANNEL_NUM));
+        stbi_write_png_compression_level = 8;
+        return ret;
+}
+
 void utilPutDword(uint8_t *p, uint32_t value)
 {
         *p++ = value & 255;
@@ -426,6 +451,46 @@ bool utilWriteBMPFile(const char *fileName, int w, int h, uint8_t *pix)
         return true;
 }
 
+// unlike utilWriteBMPFile, leaves reporting errors to the caller
+bool utilWriteRGBBMPFile(const char *fileName, int w, int h, const uint8_t *rgb)
+{
+        FILE *fp = fopen(fileName, "wb");
+
+        if (!fp)
+                return false;
+
+        uint8_t bmpheader[0x36];
+        memset(bmpheader, 0, sizeof(bmpheader));
+
+        bmpheader[0] = 'B';
+        bmpheader[1] = 'M';
+        utilPutDword(&bmpheader[2], sizeof(bmpheader) + w * h * 3);
+        utilPutDword(&bmpheader[10], 0x36);
+        utilPutDword(&bmpheader[14], 0x28);
+        utilPutDword(&bmpheader[18], w);
+        utilPutDword(&bmpheader[22], h);
+        utilPutWord(&bmpheader[26], 1);
+        utilPutWord(&bmpheader[28], 24);
+        utilPutDword(&bmpheader[34], 3 * w * h);
+
+        bool ok = fwrite(bmpheader, 1, sizeof(bmpheader), fp) == sizeof(bmpheader);
+        std::vector<uint8_t> writeBuffer(3 * w);
+
+        // bottom-up BGR
+        for (int y = h - 1; ok && y >= 0; y--) {
+                const uint8_t *p = rgb + y * w * 3;
+                uint8_t *b = writeBuffer.data();
+                for (int x = 0; x < w; x++, p += 3) {
+                        *b++ = p[2];
+                        *b++ = p[1];
+                        *b++ = p[0];
+                }
+                ok = fwrite(writeBuffer.data(), 1, 3 * w, fp) == (size_t)(3 * w);
+        }
+
+        return !fclose(fp) && ok;
+}
+
 extern bool cpuIsMultiBoot;
 
 bool utilIsGBAImage(const char *file)
@@ -494,47 +559,31 @@ void utilStripDoubleExtension(const char *file, char *buffer)
         }
 }
 
-// Opens and scans archive using accept(). Returns fex_t if found.
-// If error or not found, displays message and returns NULL.
-static fex_t *scan_arc(const char *file, bool (*accept)(const char *), char (&buffer)[2048])
+static ArchiveIndex archiveIndex;
+
+void utilSetArchiveCacheDir(const char *dir)
 {
-        fex_t *fe;
-        fex_err_t err = fex_open(&fe, file);
-        if (!fe) {
-                systemMessage(MSG_CANNOT_OPEN_FILE, N_("Cannot open file %s: %s"), file, err);
+        archiveIndex.SetCacheDir(dir);
+}
+
+// Finds the first member of an archive that accept() takes, leaving its
+// name in buffer. If error or not found, displays message and returns NULL.
+static const ArchiveIndex::Member *find_member(const char *file, bool (*accept)(const char *), char (&buffer)[2048])
+{
+        const std::vector<ArchiveIndex::Member> *members = archiveIndex.GetMembers(file);
+        if (!members)
                 return NULL;
-        }
 
-        // Scan filenames
-        bool found = false;
-        while (!fex_done(fe)) {
-                strncpy(buffer, fex_name(fe), sizeof buffer);
+        for (size_t i = 0; i < members->size(); i++) {
+                strncpy(buffer, (*members)[i].name.c_str(), sizeof buffer);
                 buffer[sizeof buffer - 1] = '\0';
 
-                utilStripDoubleExtension(buffer, buffer);
-
-                if (accept(buffer)) {
-                        found = true;
-                        break;
-                }
-
-                fex_err_t err = fex_next(fe);
-                if (err) {
-                        systemMessage(MSG_BAD_ZIP_FILE,
-                                      N_("Cannot read archive %s: %s"),
-                                      file,
-                                      err);
-                        fex_close(fe);
-                        return NULL;
-                }
+                if (accept(buffer))
+                        return &(*members)[i];
         }
 
-        if (!found) {
-                systemMessage(MSG_NO_IMAGE_ON_ZIP, N_("No image found in file %s"), file);
-                fex_close(fe);
-                return NULL;
-        }
-        return fe;
+        systemMessage(MSG_NO_IMAGE_ON_ZIP, N_("No image found in file %s"), file);
+        return NULL;
 }
 
 static bool utilIsImage(const char *file)
@@ -564,20 +613,16 @@ IMAGE_TYPE utilFindType(const char *file, char (&buffer)[2048])
         char *file_conv = (char *)file;
         //	if ( !utilIsImage( file_conv ) ) // TODO: utilIsArchive() instead?
         //	{
-        fex_t *fe = scan_arc(file_conv, utilIsImage, buffer);
-        if (!fe)
+        if (!find_member(file_conv, utilIsImage, buffer))
                 return IMAGE_UNKNOWN;
-        fex_close(fe);
         file = buffer;
         //	}
         //free(file_conv);
 #else
         //	if ( !utilIsImage( file ) ) // TODO: utilIsArchive() instead?
         //	{
-        fex_t *fe = scan_arc(file, utilIsImage, buffer);
-        if (!fe)
+        if (!find_member(file, utilIsImage, buffer))
                 return IMAGE_UNKNOWN;
-        fex_close(fe);
         file = buffer;
 //	}
 #endif
@@ -607,18 +652,17 @@ uint8_t *utilLoad(const char *file, bool (*accept)(const char *), uint8_t *data,
         //char *file_conv = fex_wide_to_path(file);
         char *file_conv = (char *)file;
         delete[] pwText;
-        fex_t *fe = scan_arc(file_conv, accept, buffer);
-        if (!fe)
+        const ArchiveIndex::Member *member = find_member(file_conv, accept, buffer);
+        if (!member)
                 return NULL;
         //free(file_conv);
 #else
-        fex_t *fe = scan_arc(file, accept, buffer);
-        if (!fe)
+        const ArchiveIndex::Member *member = find_member(file, accept, buffer);
+        if (!member)
                 return NULL;
 #endif
         // Allocate space for image
-        fex_err_t err = fex_stat(fe);
-        int fileSize = fex_size(fe);
+        int fileSize = member->size;
         if (size == 0)
                 size = fileSize;
 
@@ -631,7 +675,6 @@ uint8_t *utilLoad(const char *file, bool (*accept)(const char *), uint8_t *data,
                 // allocate buffer memory if none was passed to the function
                 image = (uint8_t *)malloc(utilGetSize(size));
                 if (image == NULL) {
-                        fex_close(fe);
                         systemMessage(MSG_OUT_OF_MEMORY,
                                       N_("Failed to allocate memory for %s"),
                                       "data");
@@ -642,8 +685,7 @@ uint8_t *utilLoad(const char *file, bool (*accept)(const char *), uint8_t *data,
 
         // Read image
         int read = fileSize <= size ? fileSize : size; // do not read beyond file
-        err = fex_read(fe, image, read);
-        fex_close(fe);
+        fex_err_t err = archiveIndex.Read(file, *member, image, read);
         if (err) {
                 systemMessage(MSG_ERROR_READING_IMAGE,
                               N_("Error reading image from %s: %s"),
@@ -816,56 +858,10 @@ long utilGzMemTell(gzFile file)
 
 void utilGBAFindSave(const int size)
 {
-        uint32_t *p = (uint32_t *)&rom[0];
-        uint32_t *end = (uint32_t *)(&rom[0] + size);
-        int detectedSaveType = 0;
-        int flashSize = 0x10000;
-        bool rtcFound = false;
-
-        while (p < end) {
-                uint32_t d = READ32LE(p);
+        int flashSize;
+        bool rtcFound;
+        int detectedSaveType = utilGBAFindSaveType(rom, size, flashSize, rtcFound);
 
-                if (d == 0x52504545) {
-                        if (memcmp(p, "EEPROM_", 7) == 0) {
-                                if (detectedSaveType == 0 || detectedSaveType == 4)
-                                        detectedSaveType = 1;
-                        }
-                } else if (d == 0x4D415253) {
-                        if (memcmp(p, "SRAM_", 5) == 0) {
-                                if (detectedSaveType == 0 || detectedSaveType == 1 ||
-                                    detectedSaveType == 4)
-                                        detectedSaveType = 2;
-                        }
-                } else if (d == 0x53414C46) {
-                        if (memcmp(p, "FLASH1M_", 8) == 0) {
-                                if (detectedSaveType == 0) {
-                                        detectedSaveType = 3;
-                                        flashSize = 0x20000;
-                                }
-                        } else if (memcmp(p, "FLASH512_", 9) == 0) {
-                                if (detectedSaveType == 0) {
-                                        detectedSaveType = 3;
-                                        flashSize = 0x10000;
-                                }
-                        } else if (memcmp(p, "FLASH", 5) == 0) {
-                                if (detectedSaveType == 0) {
-                                        detectedSaveType = 4;
-                                        flashSize = 0x10000;
-                                }
-                        }
-                } else if (d == 0x52494953) {
-                        if (memcmp(p, "SIIRTC_V", 8) == 0)
-                                rtcFound = true;
-                }
-                p++;
-        }
-        // if no matches found, then set it to NONE
-        if (detectedSaveType == 0) {
-                detectedSaveType = 5;
-        }
-        if (detectedSaveType == 4) {
-                detectedSaveType = 3;
-        }
         rtcEnable(rtcFound);
         rtcEnableRumble(!rtcFound);
         saveType = detectedSaveType;
@@ -28,6 +28,9 @@ std::string get_xdg_user_data_home();
 void utilReadScreenPixels(uint8_t *dest, int w, int h);
 bool utilWritePNGFile(const char *, int, int, uint8_t *);
 bool utilWriteBMPFile(const char *, int, int, uint8_t *);
+void utilPixToRGB(uint8_t *, int, int, uint8_t *);
+bool utilWriteRGBPNGFile(const char *, int, int, const uint8_t *, int);
+bool utilWriteRGBBMPFile(const char *, int, int, const uint8_t *);
 void utilApplyIPS(const char *ips, uint8_t **rom, int *size);
 bool utilIsGBAImage(const char *);
 bool utilIsGBImage(const char *);
@@ -36,11 +39,15 @@ bool utilIsZipFile(const char *);
 void utilStripDoubleExtension(const char *, char *);
 IMAGE_TYPE utilFindType(const char *);
 uint8_t *utilLoad(const char *, bool (*)(const char *), uint8_t *, int &);
+// where archive contents are remembered across runs
+void utilSetArchiveCacheDir(const char *dir);
 void utilExtract(const char *filepath, const char *filename);
 
 void utilPutDword(uint8_t *, uint32_t);
 void utilPutWord(uint8_t *, uint16_t);
 void utilGBAFindSave(const int);
+// save type of a GBA image, as utilGBAFindSave() would set it
+int utilGBAFindSaveType(const uint8_t *data, int size, int &flashSize, bool &rtcFound);
 void utilUpdateSystemColorMaps(bool lcd = false);
 bool utilFileExists(const char *filename);
 
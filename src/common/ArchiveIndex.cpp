@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "../NLS.h"
+#include "../System.h"
+#include "../Util.h"
+#include "ArchiveIndex.h"
+
+#include "fex/fex.h"
+
+// total size of the extracted images kept
+#define ARCHIVE_CACHE_SIZE (256 * 1024 * 1024)
+#define ARCHIVE_INDEX_HEADER "VBA-M archive index 2"
+
+#ifdef _WIN32
+wchar_t* utf8ToUtf16(const char* utf8);
+#endif
+
+static bool fileStat(const char* file, int64_t& mtime, int64_t& size)
+{
+#ifdef _WIN32
+    wchar_t* wfile = utf8ToUtf16(file);
+    struct _stat64 st;
+    bool ok = wfile && _wstat64(wfile, &st) == 0;
+    delete[] wfile;
+#else
+    struct stat st;
+    bool ok = stat(file, &st) == 0;
+#endif
+    if (ok) {
+        mtime = st.st_mtime;
+        size = st.st_size;
+    }
+    return ok;
+}
+
+static void makeDir(const std::string& dir)
+{
+#ifdef _WIN32
+    wchar_t* wdir = utf8ToUtf16(dir.c_str());
+    if (wdir) {
+        _wmkdir(wdir);
+        delete[] wdir;
+    }
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+}
+
+static void removeFile(const std::string& name)
+{
+#ifdef _WIN32
+    wchar_t* wname = utf8ToUtf16(name.c_str());
+    if (wname) {
+        _wremove(wname);
+        delete[] wname;
+    }
+#else
+    remove(name.c_str());
+#endif
+}
+
+ArchiveIndex::ArchiveIndex()
+    : useCounter(0)
+    , loaded(false)
+{
+}
+
+void ArchiveIndex::SetCacheDir(const char* dir)
+{
+    cacheDir = dir;
+    archives.clear();
+    images.clear();
+    useCounter = 0;
+    loaded = false;
+}
+
+const std::vector<ArchiveIndex::Member>* ArchiveIndex::GetMembers(const char* file)
+{
+    if (!loaded)
+        load();
+
+    int64_t mtime = -1, size = -1;
+    fileStat(file, mtime, size);
+
+    std::map<std::string, Archive>::iterator it = archives.find(file);
+    if (it != archives.end() && it->second.mtime == mtime && it->second.size == size)
+        return &it->second.members;
+
+    Archive arc;
+    arc.mtime = mtime;
+    arc.size = size;
+    if (!scan(file, arc))
+        return NULL;
+
+    Archive& entry = archives[file];
+    entry = arc;
+    if (entry.archive)
+        save();
+    return &entry.members;
+}
+
+bool ArchiveIndex::scan(const char* file, Archive& arc)
+{
+    fex_t* fe;
+    fex_err_t err = fex_open(&fe, file);
+    if (!fe) {
+        systemMessage(MSG_CANNOT_OPEN_FILE, N_("Cannot open file %s: %s"), file, err);
+        return false;
+    }
+
+    const char* ext = fex_type_extension(fex_type(fe));
+    arc.archive = *ext != '\0';
+    arc.solid = !strcmp(ext, ".7z") || !strcmp(ext, ".rar");
+
+    while (!fex_done(fe)) {
+        char buffer[2048];
+        strncpy(buffer, fex_name(fe), sizeof buffer);
+        buffer[sizeof buffer - 1] = '\0';
+        utilStripDoubleExtension(buffer, buffer);
+
+        Member m;
+        m.name = buffer;
+        m.pos = fex_tell_arc(fe);
+        if (!fex_stat(fe)) {
+            m.size = fex_size(fe);
+            m.crc = fex_crc32(fe);
+            arc.members.push_back(m);
+        }
+
+        err = fex_next(fe);
+        if (err) {
+            systemMessage(MSG_BAD_ZIP_FILE, N_("Cannot read archive %s: %s"), file, err);
+            break;
+        }
+    }
+
+    fex_close(fe);
+    return !err;
+}
+
+const char* ArchiveIndex::Read(const char* file, const Member& m, uint8_t* out, int n)
+{
+    std::map<std::string, Archive>::iterator it = archives.find(file);
+    bool cacheable = it != archives.end() && it->second.solid && !cacheDir.empty()
+        && m.crc && m.size == n && n <= ARCHIVE_CACHE_SIZE;
+
+    if (cacheable && read_cached(m, out, n))
+        return NULL;
+
+    fex_t* fe;
+    fex_err_t err = fex_open(&fe, file);
+    if (!fe)
+        return err;
+
+    err = fex_seek_arc(fe, m.pos);
+    if (!err)
+        err = fex_stat(fe);
+    if (!err)
+        err = fex_read(fe, out, n);
+    fex_close(fe);
+
+    if (!err && cacheable)
+        store_cached(m, out);
+    return err;
+}
+
+std::string ArchiveIndex::image_name(const Member& m)
+{
+    char name[32];
+    snprintf(name, sizeof name, "%08x-%d.rom", m.crc, m.size);
+    return name;
+}
+
+bool ArchiveIndex::read_cached(const Member& m, uint8_t* out, int n)
+{
+    std::string name = image_name(m);
+    std::map<std::string, Image>::iterator it = images.find(name);
+    if (it == images.end())
+        return false;
+
+    FILE* f = utilOpenFile((cacheDir + FILE_SEP + name).c_str(), "rb");
+    bool ok = f && fread(out, 1, n, f) == (size_t)n;
+    if (f)
+        fclose(f);
+
+    // the cache is only a copy; anything wrong with it and it's gone
+    if (!ok || crc32(crc32(0L, Z_NULL, 0), out, n) != m.crc) {
+        removeFile(cacheDir + FILE_SEP + name);
+        images.erase(it);
+        save();
+        return false;
+    }
+
+    // a hit only reorders the images; the new order is written along
+    // with the next change to the index, rather than on every load
+    it->second.lastUse = ++useCounter;
+    return true;
+}
+
+void ArchiveIndex::store_cached(const Member& m, const uint8_t* data)
+{
+    std::string name = image_name(m);
+
+    makeDir(cacheDir);
+    FILE* f = utilOpenFile((cacheDir + FILE_SEP + name).c_str(), "wb");
+    if (!f)
+        return;
+    bool ok = fwrite(data, 1, m.size, f) == (size_t)m.size;
+    ok = !fclose(f) && ok;
+    if (!ok) {
+        removeFile(cacheDir + FILE_SEP + name);
+        return;
+    }
+
+    Image& image = images[name];
+    image.size = m.size;
+    image.lastUse = ++useCounter;
+
+    int64_t total = 0;
+    for (std::map<std::string, Image>::iterator it = images.begin(); it != images.end(); ++it)
+        total += it->second.size;
+
+    while (total > ARCHIVE_CACHE_SIZE && images.size() > 1) {
+        std::map<std::string, Image>::iterator oldest = images.begin();
+        for (std::map<std::string, Image>::iterator it = images.begin(); it != images.end(); ++it)
+            if (it->second.lastUse < oldest->second.lastUse)
+                oldest = it;
+
+        total -= oldest->second.size;
+        removeFile(cacheDir + FILE_SEP + oldest->first);
+        images.erase(oldest);
+    }
+
+    save();
+}
+
+// the index is a text file:
+//   a <mtime> <size> <solid> <archive path>
+//   m <pos> <size> <crc> <name>            for each member of the archive
+//   i <size> <last use> <image file>       for each extracted image
+void ArchiveIndex::load()
+{
+    loaded = true;
+    if (cacheDir.empty())
+        return;
+
+    FILE* f = utilOpenFile((cacheDir + FILE_SEP + "index.txt").c_str(), "rb");
+    if (!f)
+        return;
+
+    char line[4096];
+    Archive* arc = NULL;
+
+    if (fgets(line, sizeof line, f) && !strcmp(line, ARCHIVE_INDEX_HEADER "\n")) {
+        while (fgets(line, sizeof line, f)) {
+            size_t len = strlen(line);
+            if (!len || line[len - 1] != '\n')
+                break; // truncated
+            line[len - 1] = '\0';
+
+            long long a, b;
+            unsigned crc;
+            int c, d, n = 0;
+
+            if (sscanf(line, "a %lld %lld %d %n", &a, &b, &c, &n) == 3 && n) {
+                arc = &archives[line + n];
+                arc->mtime = a;
+                arc->size = b;
+                arc->archive = true;
+                arc->solid = c != 0;
+                arc->members.clear();
+            } else if (arc && sscanf(line, "m %d %d %x %n", &c, &d, &crc, &n) == 3 && n) {
+                Member m;
+                m.name = line + n;
+                m.pos = c;
+                m.size = d;
+                m.crc = crc;
+                arc->members.push_back(m);
+            } else if (sscanf(line, "i %lld %u %n", &a, &crc, &n) == 2 && n) {
+                Image& image = images[line + n];
+                image.size = a;
+                image.lastUse = crc;
+                if (crc > useCounter)
+                    useCounter = crc;
+            }
+        }
+    }
+
+    fclose(f);
+}
+
+void ArchiveIndex::save()
+{
+    if (cacheDir.empty())
+        return;
+
+    makeDir(cacheDir);
+    FILE* f = utilOpenFile((cacheDir + FILE_SEP + "index.txt").c_str(), "wb");
+    if (!f)
+        return;
+
+    fprintf(f, "%s\n", ARCHIVE_INDEX_HEADER);
+
+    for (std::map<std::string, Archive>::iterator it = archives.begin(); it != archives.end(); ++it) {
+        const Archive& arc = it->second;
+        if (!arc.archive || it->first.find('\n') != std::string::npos)
+            continue;
+
+        fprintf(f, "a %lld %lld %d %s\n", (long long)arc.mtime, (long long)arc.size, arc.solid, it->first.c_str());
+        for (size_t i = 0; i < arc.members.size(); i++) {
+            const Member& m = arc.members[i];
+            fprintf(f, "m %d %d %08x %s\n", m.pos, m.size, m.crc, m.name.c_str());
+        }
+    }
+
+    for (std::map<std::string, Image>::iterator it = images.begin(); it != images.end(); ++it)
+        fprintf(f, "i %lld %u %s\n", (long long)it->second.size, it->second.lastUse, it->first.c_str());
+
+    fclose(f);
+}
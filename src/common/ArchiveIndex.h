@@ -0,0 +1,65 @@
+#ifndef ARCHIVEINDEX_H
+#define ARCHIVEINDEX_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Remembers what is in ROM archives, so that finding the image in an
+// archive and loading it takes one scan instead of two, and none at all
+// the next time.  Archives are keyed by path, size and modification time;
+// one that changed is simply scanned again.
+//
+// Images from 7z and RAR archives, which can only be reached by
+// decompressing everything stored before them, are also kept once
+// extracted, keyed by CRC and size.  With a cache directory set, the index
+// and those images persist across runs; the images are limited in total
+// size, the least recently used going first.
+class ArchiveIndex {
+public:
+    struct Member {
+        std::string name; // with .gz or .z stripped
+        int pos; // for fex_seek_arc()
+        int size;
+        uint32_t crc;
+    };
+
+    ArchiveIndex();
+
+    void SetCacheDir(const char* dir);
+    // members of file, scanning it unless it is known; NULL if it can't
+    // be read, after telling the user
+    const std::vector<Member>* GetMembers(const char* file);
+    // reads the first n bytes of member m of file; returns the fex error
+    const char* Read(const char* file, const Member& m, uint8_t* out, int n);
+
+private:
+    struct Archive {
+        int64_t mtime;
+        int64_t size;
+        bool archive; // false for a plain ROM, which isn't saved
+        bool solid; // 7z or RAR, whose images are worth caching
+        std::vector<Member> members;
+    };
+
+    struct Image {
+        int64_t size;
+        uint32_t lastUse;
+    };
+
+    std::string cacheDir;
+    std::map<std::string, Archive> archives;
+    std::map<std::string, Image> images; // by image_name()
+    uint32_t useCounter;
+    bool loaded;
+
+    void load();
+    void save();
+    bool scan(const char* file, Archive& arc);
+    bool read_cached(const Member& m, uint8_t* out, int n);
+    void store_cached(const Member& m, const uint8_t* data);
+    std::string image_name(const Member& m);
+};
+
+#endif // ARCHIVEINDEX_H
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "../Util.h"
+#include "BatteryJournal.h"
+
+// granularity of change detection
+#define BATTERY_BLOCK_SIZE 256
+// fold the journal into the battery file once it is this much larger
+#define BATTERY_JOURNAL_SLACK 4
+
+#ifdef _WIN32
+wchar_t* utf8ToUtf16(const char* utf8);
+#endif
+
+// journal records are <offset>.32 <length>.32 <crc>.32 <data>, the crc
+// covering offset, length and data
+static uint32_t recordCrc(const uint32_t* hdr, const uint8_t* data)
+{
+    uLong crc = crc32(0L, (const Bytef*)hdr, 2 * sizeof(uint32_t));
+    return crc32(crc, data, hdr[1]);
+}
+
+static std::string journalName(const char* fileName)
+{
+    return std::string(fileName) + ".jnl";
+}
+
+static void removeFile(const char* name)
+{
+#ifdef _WIN32
+    wchar_t* wname = utf8ToUtf16(name);
+    if (wname) {
+        _wremove(wname);
+        delete[] wname;
+    }
+#else
+    remove(name);
+#endif
+}
+
+static bool replaceFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+    wchar_t* wfrom = utf8ToUtf16(from);
+    wchar_t* wto = utf8ToUtf16(to);
+    bool ok = wfrom && wto;
+    if (ok) {
+        _wremove(wto);
+        ok = _wrename(wfrom, wto) == 0;
+    }
+    delete[] wfrom;
+    delete[] wto;
+    return ok;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+BatteryJournal::BatteryJournal()
+    : havePending(false)
+    , stopWriter(false)
+    , failed(false)
+    , journalSize(0)
+    , journal(NULL)
+{
+}
+
+BatteryJournal::~BatteryJournal()
+{
+    Close();
+}
+
+bool BatteryJournal::Replay(const char* fileName, uint8_t* data, int size)
+{
+    FILE* f = utilOpenFile(journalName(fileName).c_str(), "rb");
+
+    if (!f)
+        return false;
+
+    std::vector<uint8_t> buf;
+    uint32_t hdr[3];
+
+    // stop at the first record that is out of range or torn
+    while (fread(hdr, sizeof(hdr), 1, f) == 1) {
+        if (!hdr[1] || hdr[1] > (uint32_t)size || hdr[0] > (uint32_t)size - hdr[1])
+            break;
+
+        buf.resize(hdr[1]);
+
+        if (fread(&buf[0], 1, hdr[1], f) != hdr[1] || recordCrc(hdr, &buf[0]) != hdr[2])
+            break;
+
+        memcpy(data + hdr[0], &buf[0], hdr[1]);
+    }
+
+    fclose(f);
+    return true;
+}
+
+void BatteryJournal::Remove(const char* fileName)
+{
+    removeFile(journalName(fileName).c_str());
+}
+
+bool BatteryJournal::Open(const char* name, int size)
+{
+    Close();
+    fileName = name;
+    havePending = stopWriter = failed = false;
+    journalSize = 0;
+
+    // find out what the disk holds; if the file does not match the
+    // battery's size, the first save writes it in full
+    disk.clear();
+    FILE* f = utilOpenFile(name, "rb");
+
+    if (f) {
+        fseek(f, 0, SEEK_END);
+
+        if (ftell(f) == size) {
+            disk.resize(size);
+            fseek(f, 0, SEEK_SET);
+
+            if (fread(&disk[0], 1, size, f) != (size_t)size)
+                disk.clear();
+        }
+
+        fclose(f);
+    }
+
+    // a journal left over from a crash may end in a torn record, so fold
+    // it in before appending to it again
+    if (!disk.empty() && Replay(name, &disk[0], size)) {
+        current = disk;
+
+        if (!compact())
+            return false;
+    }
+
+    writer = std::thread(&BatteryJournal::run_writer, this);
+    return true;
+}
+
+bool BatteryJournal::Save(const uint8_t* data, int size)
+{
+    if (!IsOpen())
+        return false;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (failed)
+            return false;
+
+        pending.assign(data, data + size);
+        havePending = true;
+    }
+    cond.notify_one();
+    return true;
+}
+
+void BatteryJournal::Close()
+{
+    if (!writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopWriter = true;
+    }
+    cond.notify_one();
+    writer.join();
+
+    // leave a complete battery file behind
+    if (journalSize && !failed) {
+        current = disk;
+        compact();
+    }
+
+    if (journal) {
+        fclose(journal);
+        journal = NULL;
+    }
+}
+
+void BatteryJournal::run_writer()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    for (;;) {
+        while (!havePending && !stopWriter)
+            cond.wait(guard);
+
+        if (!havePending)
+            break;
+
+        current.swap(pending);
+        havePending = false;
+        guard.unlock();
+        bool ok = current.size() == disk.size() ? write_changes() : compact();
+        guard.lock();
+
+        if (!ok)
+            failed = true;
+    }
+}
+
+// append the blocks of current that differ from disk
+bool BatteryJournal::write_changes()
+{
+    size_t size = disk.size();
+
+    for (size_t block = 0; block < size;) {
+        size_t len = size - block < BATTERY_BLOCK_SIZE ? size - block : BATTERY_BLOCK_SIZE;
+
+        if (!memcmp(&current[block], &disk[block], len)) {
+            block += len;
+            continue;
+        }
+
+        // merge runs of changed blocks into one record
+        size_t end = block + len;
+
+        while (end < size) {
+            len = size - end < BATTERY_BLOCK_SIZE ? size - end : BATTERY_BLOCK_SIZE;
+
+            if (!memcmp(&current[end], &disk[end], len))
+                break;
+
+            end += len;
+        }
+
+        if (!journal && !(journal = utilOpenFile(journalName(fileName.c_str()).c_str(), "ab")))
+            return false;
+
+        uint32_t hdr[3] = { (uint32_t)block, (uint32_t)(end - block), 0 };
+        hdr[2] = recordCrc(hdr, &current[block]);
+
+        if (fwrite(hdr, sizeof(hdr), 1, journal) != 1 || fwrite(&current[block], 1, end - block, journal) != end - block)
+            return false;
+
+        memcpy(&disk[block], &current[block], end - block);
+        journalSize += sizeof(hdr) + end - block;
+        block = end;
+    }
+
+    if (journal && fflush(journal))
+        return false;
+
+    if (journalSize > (long)size * BATTERY_JOURNAL_SLACK)
+        return compact();
+
+    return true;
+}
+
+// replace the battery file with current and start a fresh journal
+bool BatteryJournal::compact()
+{
+    if (journal) {
+        fclose(journal);
+        journal = NULL;
+    }
+
+    std::string tmp = fileName + ".tmp";
+    FILE* f = utilOpenFile(tmp.c_str(), "wb");
+
+    if (!f)
+        return false;
+
+    bool ok = fwrite(&current[0], 1, current.size(), f) == current.size();
+    ok = !fclose(f) && ok;
+
+    if (!ok || !replaceFile(tmp.c_str(), fileName.c_str()))
+        return false;
+
+    Remove(fileName.c_str());
+    disk = current;
+    journalSize = 0;
+    return true;
+}
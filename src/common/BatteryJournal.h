@@ -0,0 +1,64 @@
+#ifndef BATTERYJOURNAL_H
+#define BATTERYJOURNAL_H
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keeps a battery file up to date without writing it on the emulation
+// thread.  Save() only copies the battery; a writer thread compares the
+// copy with what is on disk and appends the blocks that changed to
+// <file>.jnl, folding the journal back into the battery file when it
+// grows too large.  Each journal record carries a CRC, so a record torn
+// by a crash is simply ignored on the next load.
+//
+// Only for battery files that are a plain dump of one buffer; anything
+// else (RTC data and such) is still written in full by the core.
+class BatteryJournal {
+public:
+    BatteryJournal();
+    ~BatteryJournal();
+
+    // start journaling fileName, a battery of size bytes
+    bool Open(const char* fileName, int size);
+    // queue a copy of the battery; false if it must be written in full
+    bool Save(const uint8_t* data, int size);
+    // write out anything pending and stop the writer
+    void Close();
+    bool IsOpen()
+    {
+        return writer.joinable();
+    }
+    const std::string& GetFileName()
+    {
+        return fileName;
+    }
+
+    // apply the journal of fileName to a freshly loaded battery
+    static bool Replay(const char* fileName, uint8_t* data, int size);
+    // drop the journal once fileName has been written in full
+    static void Remove(const char* fileName);
+
+private:
+    std::string fileName;
+    std::vector<uint8_t> disk;    // battery contents as on disk
+    std::vector<uint8_t> pending; // latest copy from Save()
+    std::vector<uint8_t> current; // copy being written
+    bool havePending;
+    bool stopWriter;
+    bool failed;
+    long journalSize;
+    FILE* journal;
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable cond;
+
+    void run_writer();
+    bool write_changes();
+    bool compact();
+};
+
+#endif // BATTERYJOURNAL_H
@@ -101,6 +101,7 @@ enum named_opts
 	OPT_ROM_DIR_GBC,
 	OPT_RTC_ENABLED,
 	OPT_SAVE_DIR,
+	OPT_SCAN_ROMS,
 	OPT_SCREEN_SHOT_DIR,
 	OPT_SHOW_SPEED,
 	OPT_SHOW_SPEED_TRANSPARENT,
@@ -150,6 +151,7 @@ const char* romDirGB;
 const char* romDirGBA;
 const char* romDirGBC;
 const char* saveDir;
+const char* scanRomsDir;
 const char* screenShotDir;
 const char* soundRecordDir;
 int active = 1;
@@ -379,6 +381,7 @@ struct option argOptions[] = {
 	{ "save-sensor", no_argument, &cpuSaveType, 4 },
 	{ "save-sram", no_argument, &cpuSaveType, 2 },
 	{ "save-type", required_argument, 0, 't' },
+	{ "scan-roms", required_argument, 0, OPT_SCAN_ROMS },
 	{ "screen-shot-dir", required_argument, 0, OPT_SCREEN_SHOT_DIR },
 	{ "show-speed", required_argument, 0, OPT_SHOW_SPEED },
 	{ "show-speed-detailed", no_argument, &showSpeed, 2 },
@@ -1300,6 +1303,11 @@ int ReadOpts(int argc, char ** argv)
 			saveDir = optarg;
 			break;
 
+		case OPT_SCAN_ROMS:
+			// --scan-roms
+			scanRomsDir = optarg;
+			break;
+
 		case OPT_BATTERY_DIR:
 			// --battery-dir
 			batteryDir = optarg;
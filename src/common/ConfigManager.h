@@ -166,6 +166,7 @@ extern IFBFilterFunc ifbFunction;
 extern char *homeDir;
 extern const char *screenShotDir;
 extern const char *saveDir;
+extern const char *scanRomsDir;
 extern const char *batteryDir;
 
 // Directory within homedir to use for default save location.
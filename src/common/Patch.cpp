@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #ifndef __LIBRETRO__
+#include <thread>
 #include <zlib.h>
 #endif
 
@@ -34,43 +35,161 @@ typedef off64_t __off64_t;
 typedef __int64 __off64_t;
 #endif
 
-static int readInt2(FILE* f)
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+// Patches are read through a buffer rather than a byte at a time, and the
+// CRC of the part of the file a format checksums is kept up to date while
+// reading it in order, so checking it takes no second pass over the file.
+#define PATCH_BUFFER_SIZE 65536
+
+struct PatchFile {
+    FILE* f;
+    int64_t size;
+    int64_t bufStart; // file offset of buf[0]
+    size_t pos, len;
+    int64_t crcEnd; // the CRC covers the file up to here
+    int64_t crcDone; // and has been computed up to here, -1 if lost
+    uLong crc;
+    uint8_t buf[PATCH_BUFFER_SIZE];
+};
+
+static PatchFile* patchOpen(const char* patchname)
+{
+    FILE* f = utilOpenFile(patchname, "rb");
+    if (!f)
+        return NULL;
+
+    PatchFile* p = new PatchFile;
+    p->f = f;
+    fseeko64(f, 0, SEEK_END);
+    p->size = ftello64(f);
+    fseeko64(f, 0, SEEK_SET);
+    p->bufStart = 0;
+    p->pos = p->len = 0;
+    p->crcEnd = 0;
+    p->crcDone = -1;
+    p->crc = 0;
+    return p;
+}
+
+static void patchClose(PatchFile* p)
+{
+    fclose(p->f);
+    delete p;
+}
+
+static void patchSeek(PatchFile* p, int64_t offset)
+{
+    fseeko64(p->f, offset, SEEK_SET);
+    p->bufStart = offset;
+    p->pos = p->len = 0;
+}
+
+// reads from the start of the file on, checksumming it up to end
+static void patchStartCRC(PatchFile* p, int64_t end)
+{
+    patchSeek(p, 0);
+    p->crcEnd = end;
+    p->crcDone = 0;
+    p->crc = crc32(0L, Z_NULL, 0);
+}
+
+// loads the next block; false at the end of the file
+static bool patchFill(PatchFile* p)
+{
+    p->bufStart += p->len;
+    p->pos = 0;
+    p->len = fread(p->buf, 1, sizeof p->buf, p->f);
+
+    if (p->crcDone != p->bufStart)
+        p->crcDone = -1;
+    else if (p->crcDone < p->crcEnd) {
+        size_t n = (size_t)MIN((int64_t)p->len, p->crcEnd - p->crcDone);
+        p->crc = crc32(p->crc, p->buf, n);
+        p->crcDone += n;
+    }
+
+    return p->len > 0;
+}
+
+static inline int patchGetc(PatchFile* p)
+{
+    if (p->pos == p->len && !patchFill(p))
+        return EOF;
+    return p->buf[p->pos++];
+}
+
+static int64_t patchTell(PatchFile* p)
+{
+    return p->bufStart + p->pos;
+}
+
+// copies the next n bytes to out, or skips them if out is NULL
+static bool patchRead(PatchFile* p, uint8_t* out, int64_t n)
+{
+    while (n > 0) {
+        if (p->pos == p->len && !patchFill(p))
+            return false;
+        size_t chunk = (size_t)MIN((int64_t)(p->len - p->pos), n);
+        if (out) {
+            memcpy(out, p->buf + p->pos, chunk);
+            out += chunk;
+        }
+        p->pos += chunk;
+        n -= chunk;
+    }
+    return true;
+}
+
+// CRC from patchStartCRC(), reading whatever it covers that is left; false
+// if the file was not read in order
+static bool patchFileCRC(PatchFile* p, uint32_t& crc)
+{
+    while (p->crcDone >= 0 && p->crcDone < p->crcEnd && patchFill(p))
+        ;
+    crc = p->crc;
+    return p->crcDone == p->crcEnd;
+}
+
+static int readInt2(PatchFile* f)
 {
     int res = 0;
-    int c = fgetc(f);
+    int c = patchGetc(f);
     if (c == EOF)
         return -1;
     res = c;
-    c = fgetc(f);
+    c = patchGetc(f);
     if (c == EOF)
         return -1;
     return c + (res << 8);
 }
 
-static int readInt3(FILE* f)
+static int readInt3(PatchFile* f)
 {
     int res = 0;
-    int c = fgetc(f);
+    int c = patchGetc(f);
     if (c == EOF)
         return -1;
     res = c;
-    c = fgetc(f);
+    c = patchGetc(f);
     if (c == EOF)
         return -1;
     res = c + (res << 8);
-    c = fgetc(f);
+    c = patchGetc(f);
     if (c == EOF)
         return -1;
     return c + (res << 8);
 }
 
-static int64_t readInt4(FILE* f)
+static int64_t readInt4(PatchFile* f)
 {
     int64_t tmp, res = 0;
     int c;
 
     for (int i = 0; i < 4; i++) {
-        c = fgetc(f);
+        c = patchGetc(f);
         if (c == EOF)
             return -1;
         tmp = c;
@@ -80,13 +199,13 @@ static int64_t readInt4(FILE* f)
     return res;
 }
 
-static int64_t readInt8(FILE* f)
+static int64_t readInt8(PatchFile* f)
 {
     int64_t tmp, res = 0;
     int c;
 
     for (int i = 0; i < 8; i++) {
-        c = fgetc(f);
+        c = patchGetc(f);
         if (c == EOF)
             return -1;
         tmp = c;
@@ -96,11 +215,11 @@ static int64_t readInt8(FILE* f)
     return res;
 }
 
-static int64_t readVarPtr(FILE* f)
+static int64_t readVarPtr(PatchFile* f)
 {
     int64_t offset = 0, shift = 1;
     for (;;) {
-        int c = fgetc(f);
+        int c = patchGetc(f);
         if (c == EOF)
             return 0;
         offset += (c & 0x7F) * shift;
@@ -112,7 +231,7 @@ static int64_t readVarPtr(FILE* f)
     return offset;
 }
 
-static int64_t readSignVarPtr(FILE* f)
+static int64_t readSignVarPtr(PatchFile* f)
 {
     int64_t offset = readVarPtr(f);
     bool sign =  offset & 1;
@@ -124,28 +243,49 @@ static int64_t readSignVarPtr(FILE* f)
     return offset;
 }
 
-#ifndef MIN
-#define MIN(a, b) (((a) < (b)) ? (a) : (b))
-#endif
+// CRC of the ROM, worked out on another thread while the patch is read
+class RomCRC {
+public:
+    RomCRC(const uint8_t* data, int size)
+        : crc(0)
+        , worker(&RomCRC::run, this, data, size)
+    {
+    }
+    ~RomCRC()
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+    uint32_t Get()
+    {
+        if (worker.joinable())
+            worker.join();
+        return crc;
+    }
 
-static uLong computePatchCRC(FILE* f, unsigned int size)
+private:
+    uint32_t crc;
+    std::thread worker;
+
+    void run(const uint8_t* data, int size)
+    {
+        crc = crc32(crc32(0L, Z_NULL, 0), data, size);
+    }
+};
+
+// replaces the ROM with a patched image
+static void patchCommit(uint8_t** rom, int* size, const uint8_t* data, int64_t dataSize)
 {
-    Bytef buf[4096];
-    long readed;
-
-    uLong crc = crc32(0L, Z_NULL, 0);
-    do {
-        readed = fread(buf, 1, MIN(size, sizeof(buf)), f);
-        crc = crc32(crc, buf, readed);
-        size -= readed;
-    } while (readed > 0);
-    return crc;
+    if (dataSize > *size)
+        *rom = (uint8_t*)realloc(*rom, dataSize);
+    memcpy(*rom, data, dataSize);
+    *size = dataSize;
 }
 
 static bool patchApplyIPS(const char* patchname, uint8_t** r, int* s)
 {
     // from the IPS spec at http://zerosoft.zophar.net/ips.htm
-    FILE* f = utilOpenFile(patchname, "rb");
+    PatchFile* f = patchOpen(patchname);
     if (!f)
         return false;
 
@@ -153,7 +293,7 @@ static bool patchApplyIPS(const char* patchname, uint8_t** r, int* s)
 
     uint8_t* rom = *r;
     int size = *s;
-    if (fgetc(f) == 'P' && fgetc(f) == 'A' && fgetc(f) == 'T' && fgetc(f) == 'C' && fgetc(f) == 'H') {
+    if (patchGetc(f) == 'P' && patchGetc(f) == 'A' && patchGetc(f) == 'T' && patchGetc(f) == 'C' && patchGetc(f) == 'H') {
         int b;
         int offset;
         int len;
@@ -172,222 +312,209 @@ static bool patchApplyIPS(const char* patchname, uint8_t** r, int* s)
                 // len == 0, RLE block
                 len = readInt2(f);
                 // byte to fill
-                int c = fgetc(f);
+                int c = patchGetc(f);
                 if (c == -1)
                     break;
                 b = (uint8_t)c;
             } else
                 b = -1;
+            if (len < 0)
+                break;
             // check if we need to reallocate our ROM
             if ((offset + len) >= size) {
-                size *= 2;
+                while ((offset + len) >= size)
+                    size *= 2;
                 rom = (uint8_t*)realloc(rom, size);
                 *r = rom;
                 *s = size;
             }
             if (b == -1) {
                 // normal block, just read the data
-                if (fread(&rom[offset], 1, len, f) != (size_t)len)
+                if (!patchRead(f, &rom[offset], len))
                     break;
             } else {
                 // fill the region with the given byte
-                while (len--) {
-                    rom[offset++] = b;
-                }
+                memset(&rom[offset], b, len);
             }
         }
     }
     // close the file
-    fclose(f);
+    patchClose(f);
 
     return result;
 }
 
-static bool patchApplyUPS(const char* patchname, uint8_t** rom, int* size)
+// reads the CRCs at the end of a UPS or BPS patch and checks its magic;
+// leaves f at the start of the patch data with its CRC being taken
+static bool patchReadFooter(PatchFile* f, const char* magic, int64_t& srcCRC, int64_t& dstCRC, int64_t& patchCRC)
 {
-    int64_t srcCRC, dstCRC, patchCRC;
-
-    FILE* f = utilOpenFile(patchname, "rb");
-    if (!f)
-        return false;
-
-    fseeko64(f, 0, SEEK_END);
-    __off64_t patchSize = ftello64(f);
-    if (patchSize < 20) {
-        fclose(f);
+    if (f->size < 20)
         return false;
-    }
-
-    fseeko64(f, 0, SEEK_SET);
-    if (fgetc(f) != 'U' || fgetc(f) != 'P' || fgetc(f) != 'S' || fgetc(f) != '1') {
-        fclose(f);
-        return false;
-    }
 
-    fseeko64(f, -12, SEEK_END);
+    patchSeek(f, f->size - 12);
     srcCRC = readInt4(f);
     dstCRC = readInt4(f);
     patchCRC = readInt4(f);
-    if (srcCRC == -1 || dstCRC == -1 || patchCRC == -1) {
-        fclose(f);
+    if (srcCRC == -1 || dstCRC == -1 || patchCRC == -1)
         return false;
-    }
 
-    fseeko64(f, 0, SEEK_SET);
-    uint32_t crc = computePatchCRC(f, patchSize - 4);
+    patchStartCRC(f, f->size - 4);
+    for (int i = 0; i < 4; i++)
+        if (patchGetc(f) != magic[i])
+            return false;
 
-    if (crc != patchCRC) {
-        fclose(f);
+    return true;
+}
+
+static bool patchApplyUPS(const char* patchname, uint8_t** rom, int* size)
+{
+    int64_t srcCRC, dstCRC, patchCRC;
+
+    PatchFile* f = patchOpen(patchname);
+    if (!f)
         return false;
-    }
 
-    crc = crc32(0L, Z_NULL, 0);
-    crc = crc32(crc, *rom, *size);
+    if (!patchReadFooter(f, "UPS1", srcCRC, dstCRC, patchCRC)) {
+        patchClose(f);
+        return false;
+    }
 
-    fseeko64(f, 4, SEEK_SET);
-    int64_t dataSize;
     int64_t srcSize = readVarPtr(f);
     int64_t dstSize = readVarPtr(f);
 
-    if (crc == srcCRC) {
-        if (srcSize != *size) {
-            fclose(f);
-            return false;
-        }
+    // UPS patches work both ways; the direction only decides the size of
+    // the result, and the CRC check below which way it really was
+    int64_t dataSize;
+    if (srcSize == *size)
         dataSize = dstSize;
-    } else if (crc == dstCRC) {
-        if (dstSize != *size) {
-            fclose(f);
-            return false;
-        }
+    else if (dstSize == *size)
         dataSize = srcSize;
-    } else {
-        fclose(f);
+    else {
+        patchClose(f);
         return false;
     }
-    if (dataSize > *size) {
-        *rom = (uint8_t*)realloc(*rom, dataSize);
-        memset(*rom + *size, 0, dataSize - *size);
-        *size = dataSize;
+
+    RomCRC romCRC(*rom, *size);
+
+    uint8_t* out = (uint8_t*)malloc(dataSize);
+    if (!out) {
+        patchClose(f);
+        return false;
     }
+    memcpy(out, *rom, MIN(dataSize, (int64_t)*size));
+    if (dataSize > *size)
+        memset(out + *size, 0, dataSize - *size);
 
+    bool ok = true;
     int64_t relative = 0;
-    uint8_t* mem;
-    while (ftello64(f) < patchSize - 12) {
+    int64_t end = f->size - 12;
+
+    while (ok && patchTell(f) < end) {
         relative += readVarPtr(f);
-        if (relative > dataSize)
-            continue;
-        mem = *rom + relative;
-        for (int64_t i = relative; i < dataSize; i++) {
-            int x = fgetc(f);
+        for (;;) {
+            int x = patchGetc(f);
+            if (x == EOF) {
+                ok = false;
+                break;
+            }
             relative++;
             if (!x)
                 break;
-            if (i < dataSize) {
-                *mem++ ^= x;
-            }
+            if (relative <= dataSize)
+                out[relative - 1] ^= x;
         }
     }
 
-    fclose(f);
-    return true;
+    uint32_t crc;
+    if (ok)
+        ok = patchFileCRC(f, crc) && crc == patchCRC;
+    if (ok) {
+        crc = romCRC.Get();
+        ok = (crc == srcCRC && srcSize == *size) || (crc == dstCRC && dstSize == *size);
+    }
+    if (ok)
+        patchCommit(rom, size, out, dataSize);
+
+    free(out);
+    patchClose(f);
+    return ok;
 }
 
 static bool patchApplyBPS(const char* patchname, uint8_t** rom, int* size)
 {
     int64_t srcCRC, dstCRC, patchCRC;
 
-    FILE* f = utilOpenFile(patchname, "rb");
+    PatchFile* f = patchOpen(patchname);
     if (!f)
         return false;
 
-    fseeko64(f, 0, SEEK_END);
-    __off64_t patchSize = ftello64(f);
-    if (patchSize < 20) {
-        fclose(f);
-        return false;
-    }
-
-    fseeko64(f, 0, SEEK_SET);
-    if (fgetc(f) != 'B' || fgetc(f) != 'P' || fgetc(f) != 'S' || fgetc(f) != '1') {
-        fclose(f);
-        return false;
-    }
-
-    fseeko64(f, -12, SEEK_END);
-    srcCRC = readInt4(f);
-    dstCRC = readInt4(f);
-    patchCRC = readInt4(f);
-    if (srcCRC == -1 || dstCRC == -1 || patchCRC == -1) {
-        fclose(f);
-        return false;
-    }
-
-    fseeko64(f, 0, SEEK_SET);
-    uint32_t crc = computePatchCRC(f, patchSize - 4);
-
-    if (crc != patchCRC) {
-        fclose(f);
+    if (!patchReadFooter(f, "BPS1", srcCRC, dstCRC, patchCRC)) {
+        patchClose(f);
         return false;
     }
 
-    crc = crc32(0L, Z_NULL, 0);
-    crc = crc32(crc, *rom, *size);
-
-    fseeko64(f, 4, SEEK_SET);
-    int64_t dataSize;
     int64_t srcSize = readVarPtr(f);
-    int64_t dstSize = readVarPtr(f);
+    int64_t dataSize = readVarPtr(f);
     int64_t mtdSize = readVarPtr(f);
-    fseeko64(f, mtdSize, SEEK_CUR);
 
-    if (crc == srcCRC) {
-        if (srcSize != *size) {
-            fclose(f);
-            return false;
-        }
-        dataSize = dstSize;
-    } else if (crc == dstCRC) {
-        if (dstSize != *size) {
-            fclose(f);
-            return false;
-        }
-        dataSize = srcSize;
-    } else {
-        fclose(f);
+    // BPS only goes from source to target
+    if (srcSize != *size || !patchRead(f, NULL, mtdSize)) {
+        patchClose(f);
         return false;
     }
 
+    RomCRC romCRC(*rom, *size);
+
     uint8_t* new_rom = (uint8_t*)calloc(1, dataSize);
+    if (!new_rom) {
+        patchClose(f);
+        return false;
+    }
 
+    const uint8_t* src = *rom;
     int64_t length = 0;
     uint8_t action = 0;
-    uint32_t outputOffset = 0, sourceRelativeOffset = 0, targetRelativeOffset = 0;
+    int64_t outputOffset = 0, sourceRelativeOffset = 0, targetRelativeOffset = 0;
+    int64_t end = f->size - 12;
+    bool ok = true;
 
-    while (ftello64(f) < patchSize - 12) {
+    while (ok && patchTell(f) < end) {
         length = readVarPtr(f);
         action = length & 3 ;
         length = (length>>2) + 1;
+        if (outputOffset + length > dataSize) {
+            ok = false;
+            break;
+        }
         switch(action){
         case 0: // sourceRead
-            while(length--) {
-                new_rom[outputOffset] = rom[0][outputOffset];
-                outputOffset++;
+            if (outputOffset + length > srcSize) {
+                ok = false;
+                break;
             }
+            memcpy(&new_rom[outputOffset], &src[outputOffset], length);
+            outputOffset += length;
             break;
         case 1: // patchRead
-            while(length--) {
-                new_rom[outputOffset++] = fgetc(f);
-            }
+            ok = patchRead(f, &new_rom[outputOffset], length);
+            outputOffset += length;
             break;
         case 2: // sourceCopy
             sourceRelativeOffset += readSignVarPtr(f);
-            while(length--) {
-                new_rom[outputOffset++] = rom[0][sourceRelativeOffset++];
+            if (sourceRelativeOffset < 0 || sourceRelativeOffset + length > srcSize) {
+                ok = false;
+                break;
             }
+            memcpy(&new_rom[outputOffset], &src[sourceRelativeOffset], length);
+            outputOffset += length;
+            sourceRelativeOffset += length;
             break;
         case 3: // targetCopy
             targetRelativeOffset += readSignVarPtr(f);
+            if (targetRelativeOffset < 0 || targetRelativeOffset >= outputOffset) {
+                ok = false;
+                break;
+            }
             while(length--) { // yes, copy from alredy patched rom, and only 1 byte at time (pseudo-rle)
                 new_rom[outputOffset++] = new_rom[targetRelativeOffset++];
             }
@@ -395,29 +522,25 @@ static bool patchApplyBPS(const char* patchname, uint8_t** rom, int* size)
         }
     }
 
-    crc = crc32(0L, Z_NULL, 0);
-    crc = crc32(crc, new_rom, dataSize);
-
-    if(crc == dstCRC)
-    {
-        if (dataSize > *size) {
-            *rom = (uint8_t*)realloc(*rom, dataSize);
-        }
-        memcpy(*rom, new_rom, dataSize);
-        *size = dataSize;
-        free(new_rom);
-    }
-
-    fclose(f);
-    return true;
+    uint32_t crc;
+    if (ok)
+        ok = patchFileCRC(f, crc) && crc == patchCRC && romCRC.Get() == srcCRC;
+    if (ok)
+        ok = (int64_t)crc32(crc32(0L, Z_NULL, 0), new_rom, dataSize) == dstCRC;
+    if (ok)
+        patchCommit(rom, size, new_rom, dataSize);
+
+    free(new_rom);
+    patchClose(f);
+    return ok;
 }
 
-static int ppfVersion(FILE* f)
+static int ppfVersion(PatchFile* f)
 {
-    fseeko64(f, 0, SEEK_SET);
-    if (fgetc(f) != 'P' || fgetc(f) != 'P' || fgetc(f) != 'F') //-V501
+    patchSeek(f, 0);
+    if (patchGetc(f) != 'P' || patchGetc(f) != 'P' || patchGetc(f) != 'F') //-V501
         return 0;
-    switch (fgetc(f)) {
+    switch (patchGetc(f)) {
     case '1':
         return 1;
     case '2':
@@ -429,29 +552,28 @@ static int ppfVersion(FILE* f)
     }
 }
 
-static int ppfFileIdLen(FILE* f, int version)
+static int ppfFileIdLen(PatchFile* f, int version)
 {
     if (version == 2) {
-        fseeko64(f, -8, SEEK_END);
+        patchSeek(f, f->size - 8);
     } else {
-        fseeko64(f, -6, SEEK_END);
+        patchSeek(f, f->size - 6);
     }
 
-    if (fgetc(f) != '.' || fgetc(f) != 'D' || fgetc(f) != 'I' || fgetc(f) != 'Z')
+    if (patchGetc(f) != '.' || patchGetc(f) != 'D' || patchGetc(f) != 'I' || patchGetc(f) != 'Z')
         return 0;
 
     return (version == 2) ? readInt4(f) : readInt2(f);
 }
 
-static bool patchApplyPPF1(FILE* f, uint8_t** rom, int* size)
+static bool patchApplyPPF1(PatchFile* f, uint8_t** rom, int* size)
 {
-    fseek(f, 0, SEEK_END);
-    int count = ftell(f);
+    int count = f->size;
     if (count < 56)
         return false;
     count -= 56;
 
-    fseek(f, 56, SEEK_SET);
+    patchSeek(f, 56);
 
     uint8_t* mem = *rom;
 
@@ -459,12 +581,12 @@ static bool patchApplyPPF1(FILE* f, uint8_t** rom, int* size)
         int offset = readInt4(f);
         if (offset == -1)
             break;
-        int len = fgetc(f);
+        int len = patchGetc(f);
         if (len == EOF)
             break;
         if (offset + len > *size)
             break;
-        if (fread(&mem[offset], 1, len, f) != (size_t)len)
+        if (!patchRead(f, &mem[offset], len))
             break;
         count -= 4 + 1 + len;
     }
@@ -472,15 +594,14 @@ static bool patchApplyPPF1(FILE* f, uint8_t** rom, int* size)
     return (count == 0);
 }
 
-static bool patchApplyPPF2(FILE* f, uint8_t** rom, int* size)
+static bool patchApplyPPF2(PatchFile* f, uint8_t** rom, int* size)
 {
-    fseek(f, 0, SEEK_END);
-    int count = ftell(f);
+    int count = f->size;
     if (count < 56 + 4 + 1024)
         return false;
     count -= 56 + 4 + 1024;
 
-    fseek(f, 56, SEEK_SET);
+    patchSeek(f, 56);
 
     int datalen = readInt4(f);
     if (datalen != *size)
@@ -489,7 +610,7 @@ static bool patchApplyPPF2(FILE* f, uint8_t** rom, int* size)
     uint8_t* mem = *rom;
 
     uint8_t block[1024];
-    if (fread(&block, 1, 1024, f) == 0 ||
+    if (!patchRead(f, block, 1024) ||
             memcmp(&mem[0x9320], &block, 1024) != 0)
         return false;
 
@@ -497,18 +618,18 @@ static bool patchApplyPPF2(FILE* f, uint8_t** rom, int* size)
     if (idlen > 0)
         count -= 16 + 16 + idlen;
 
-    fseek(f, 56 + 4 + 1024, SEEK_SET);
+    patchSeek(f, 56 + 4 + 1024);
 
     while (count > 0) {
         int offset = readInt4(f);
         if (offset == -1)
             break;
-        int len = fgetc(f);
+        int len = patchGetc(f);
         if (len == EOF)
             break;
         if (offset + len > *size)
             break;
-        if (fread(&mem[offset], 1, len, f) != (size_t)len)
+        if (!patchRead(f, &mem[offset], len))
             break;
         count -= 4 + 1 + len;
     }
@@ -516,26 +637,25 @@ static bool patchApplyPPF2(FILE* f, uint8_t** rom, int* size)
     return (count == 0);
 }
 
-static bool patchApplyPPF3(FILE* f, uint8_t** rom, int* size)
+static bool patchApplyPPF3(PatchFile* f, uint8_t** rom, int* size)
 {
-    fseek(f, 0, SEEK_END);
-    int count = ftell(f);
+    int count = f->size;
     if (count < 56 + 4 + 1024)
         return false;
     count -= 56 + 4;
 
-    fseek(f, 56, SEEK_SET);
+    patchSeek(f, 56);
 
-    int imagetype = fgetc(f);
-    int blockcheck = fgetc(f);
-    int undo = fgetc(f);
-    fgetc(f);
+    int imagetype = patchGetc(f);
+    int blockcheck = patchGetc(f);
+    int undo = patchGetc(f);
+    patchGetc(f);
 
     uint8_t* mem = *rom;
 
     if (blockcheck) {
         uint8_t block[1024];
-        if (fread(&block, 1, 1024, f) == 0 ||
+        if (!patchRead(f, block, 1024) ||
                 memcmp(&mem[(imagetype == 0) ? 0x9320 : 0x80A0], &block, 1024) != 0)
             return false;
         count -= 1024;
@@ -545,21 +665,21 @@ static bool patchApplyPPF3(FILE* f, uint8_t** rom, int* size)
     if (idlen > 0)
         count -= 16 + 16 + idlen;
 
-    fseek(f, 56 + 4 + (blockcheck ? 1024 : 0), SEEK_SET);
+    patchSeek(f, 56 + 4 + (blockcheck ? 1024 : 0));
 
     while (count > 0) {
         __off64_t offset = readInt8(f);
         if (offset == -1)
             break;
-        int len = fgetc(f);
+        int len = patchGetc(f);
         if (len == EOF)
             break;
         if (offset + len > *size)
             break;
-        if (fread(&mem[offset], 1, len, f) != (size_t)len)
+        if (!patchRead(f, &mem[offset], len))
             break;
         if (undo)
-            fseeko64(f, len, SEEK_CUR);
+            patchRead(f, NULL, len);
         count -= 8 + 1 + len;
         if (undo)
             count -= len;
@@ -570,7 +690,7 @@ static bool patchApplyPPF3(FILE* f, uint8_t** rom, int* size)
 
 static bool patchApplyPPF(const char* patchname, uint8_t** rom, int* size)
 {
-    FILE* f = utilOpenFile(patchname, "rb");
+    PatchFile* f = patchOpen(patchname);
     if (!f)
         return false;
 
@@ -589,7 +709,7 @@ static bool patchApplyPPF(const char* patchname, uint8_t** rom, int* size)
         break;
     }
 
-    fclose(f);
+    patchClose(f);
     return res;
 }
 
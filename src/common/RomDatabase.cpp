@@ -0,0 +1,542 @@
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "../System.h"
+#include "../Util.h"
+#include "RomDatabase.h"
+
+#include "fex/fex.h"
+
+#define ROM_DATABASE_HEADER "VBA-M ROM database 1"
+// as utilLoad() accepts
+#define MAX_CART_SIZE 0x2000000
+
+#ifdef _WIN32
+wchar_t* utf8ToUtf16(const char* utf8);
+#endif
+
+extern bool cpuIsMultiBoot;
+
+// SHA-1 as in FIPS 180-1
+struct Sha1 {
+    uint32_t h[5];
+    uint64_t length;
+    uint8_t block[64];
+
+    Sha1()
+        : length(0)
+    {
+        h[0] = 0x67452301;
+        h[1] = 0xEFCDAB89;
+        h[2] = 0x98BADCFE;
+        h[3] = 0x10325476;
+        h[4] = 0xC3D2E1F0;
+    }
+
+    static uint32_t rol(uint32_t x, int n)
+    {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    void transform(const uint8_t* p)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+            w[i] = (p[i * 4] << 24) | (p[i * 4 + 1] << 16) | (p[i * 4 + 2] << 8) | p[i * 4 + 3];
+        for (int i = 16; i < 80; i++)
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    void update(const uint8_t* data, size_t n)
+    {
+        size_t used = length & 63;
+        length += n;
+        if (used) {
+            size_t take = 64 - used < n ? 64 - used : n;
+            memcpy(block + used, data, take);
+            data += take;
+            n -= take;
+            if (used + take < 64)
+                return;
+            transform(block);
+        }
+        for (; n >= 64; data += 64, n -= 64)
+            transform(data);
+        memcpy(block, data, n);
+    }
+
+    void final(uint8_t out[20])
+    {
+        uint64_t bits = length * 8;
+        uint8_t pad[72] = { 0x80 };
+        size_t used = length & 63;
+        size_t n = (used < 56 ? 56 : 120) - used;
+        for (int i = 0; i < 8; i++)
+            pad[n + i] = (uint8_t)(bits >> (56 - i * 8));
+        update(pad, n + 8);
+        for (int i = 0; i < 20; i++)
+            out[i] = (uint8_t)(h[i / 4] >> (24 - (i & 3) * 8));
+    }
+};
+
+// utilIsGBAImage() sets cpuIsMultiBoot as it goes, which must neither race
+// between the scanning threads nor leak out of them
+static int imageType(const char* name)
+{
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+
+    bool multiBoot = cpuIsMultiBoot;
+    int type = utilIsGBAImage(name) ? IMAGE_GBA : utilIsGBImage(name) ? IMAGE_GB : IMAGE_UNKNOWN;
+    cpuIsMultiBoot = multiBoot;
+    return type;
+}
+
+static bool isArchive(const char* name)
+{
+    fex_type_t type = fex_identify_extension(name);
+    return type && *fex_type_extension(type);
+}
+
+// header text, with anything unprintable made a space and trailing blanks
+// dropped
+static std::string headerText(const uint8_t* p, int n)
+{
+    std::string s;
+    for (int i = 0; i < n && p[i]; i++)
+        s += (p[i] >= 0x20 && p[i] < 0x7F) ? (char)p[i] : ' ';
+    while (!s.empty() && s[s.size() - 1] == ' ')
+        s.erase(s.size() - 1);
+    return s;
+}
+
+static void readHeader(RomDatabase::Entry& e, const uint8_t* data, int size)
+{
+    e.cgb = 0;
+    e.sgb = false;
+    e.saveType = 0;
+    e.saveSize = 0;
+    e.rtc = false;
+
+    if (e.type == IMAGE_GBA) {
+        if (size >= 0xC0) {
+            e.title = headerText(data + 0xA0, 12);
+            e.code = headerText(data + 0xAC, 4);
+            e.maker = headerText(data + 0xB0, 2);
+        }
+        e.saveType = utilGBAFindSaveType(data, size, e.saveSize, e.rtc);
+        if (e.saveType == 2)
+            e.saveSize = 0x8000;
+        else if (e.saveType != 3)
+            e.saveSize = 0;
+    } else if (size >= 0x150) {
+        static const int ramSizes[] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+
+        e.cgb = data[0x143] & 0x80 ? data[0x143] : 0;
+        e.sgb = data[0x146] == 0x03;
+        // CGB games share the end of the title with the manufacturer code
+        e.title = headerText(data + 0x134, e.cgb ? 11 : 16);
+        e.code = e.cgb ? headerText(data + 0x13F, 4) : "";
+        if (data[0x14B] == 0x33)
+            e.maker = headerText(data + 0x144, 2);
+        else {
+            char buffer[3];
+            snprintf(buffer, sizeof buffer, "%02X", data[0x14B]);
+            e.maker = buffer;
+        }
+        e.saveType = data[0x147];
+        e.saveSize = data[0x149] < 6 ? ramSizes[data[0x149]] : 0;
+        e.rtc = data[0x147] == 0x0F || data[0x147] == 0x10;
+    }
+}
+
+// hashes every image in file, which may be an archive
+static void scanFile(const RomDatabase::Entry& file, std::vector<RomDatabase::Entry>& out)
+{
+    fex_t* fe;
+    fex_open(&fe, file.path.c_str());
+    if (!fe)
+        return;
+
+    // a gzip file holds one unnamed image
+    const char* ext = fex_type_extension(fex_type(fe));
+    bool named = *ext && strcmp(ext, ".gz");
+    std::vector<uint8_t> data;
+
+    while (!fex_done(fe)) {
+        char name[2048];
+        strncpy(name, fex_name(fe), sizeof name);
+        name[sizeof name - 1] = '\0';
+        utilStripDoubleExtension(name, name);
+
+        int type = imageType(name);
+        if (type != IMAGE_UNKNOWN && !fex_stat(fe) && fex_size(fe) <= MAX_CART_SIZE) {
+            int size = fex_size(fe);
+            // utilGBAFindSaveType() compares a few bytes past its last word
+            data.resize(size + 16);
+            memset(&data[size], 0, 16);
+
+            if (!fex_read(fe, &data[0], size)) {
+                RomDatabase::Entry e = file;
+                e.member = named ? name : "";
+                e.type = type;
+                e.size = size;
+                e.crc = crc32(crc32(0L, Z_NULL, 0), &data[0], size);
+
+                Sha1 sha1;
+                sha1.update(&data[0], size);
+                sha1.final(e.sha1);
+
+                readHeader(e, &data[0], size);
+                out.push_back(e);
+            }
+        }
+
+        if (fex_next(fe))
+            break;
+    }
+
+    fex_close(fe);
+}
+
+static bool fileStat(const char* file, int64_t& mtime, int64_t& size, bool& dir)
+{
+#ifdef _WIN32
+    wchar_t* wfile = utf8ToUtf16(file);
+    struct _stat64 st;
+    bool ok = wfile && _wstat64(wfile, &st) == 0;
+    delete[] wfile;
+#else
+    struct stat st;
+    bool ok = stat(file, &st) == 0;
+#endif
+    if (ok) {
+        mtime = st.st_mtime;
+        size = st.st_size;
+        dir = (st.st_mode & S_IFMT) == S_IFDIR;
+    }
+    return ok;
+}
+
+static void listDir(const std::string& dir, std::vector<std::string>& names)
+{
+#ifdef _WIN32
+    wchar_t* wpattern = utf8ToUtf16((dir + FILE_SEP + "*").c_str());
+    if (!wpattern)
+        return;
+
+    struct _wfinddata_t fd;
+    intptr_t handle = _wfindfirst(wpattern, &fd);
+    delete[] wpattern;
+    if (handle == -1)
+        return;
+
+    do {
+        char name[MAX_PATH * 4];
+        if (WideCharToMultiByte(CP_UTF8, 0, fd.name, -1, name, sizeof name, NULL, NULL))
+            names.push_back(name);
+    } while (_wfindnext(handle, &fd) == 0);
+    _findclose(handle);
+#else
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+        return;
+
+    while (struct dirent* de = readdir(d))
+        names.push_back(de->d_name);
+    closedir(d);
+#endif
+}
+
+// the files under dir that may hold images
+static void walk(const std::string& dir, std::vector<RomDatabase::Entry>& files, int depth)
+{
+    std::vector<std::string> names;
+    listDir(dir, names);
+
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == "." || names[i] == "..")
+            continue;
+
+        RomDatabase::Entry file;
+        file.path = dir + FILE_SEP + names[i];
+
+        bool isDir = false;
+        if (!fileStat(file.path.c_str(), file.mtime, file.fileSize, isDir))
+            continue;
+
+        char name[2048];
+        strncpy(name, names[i].c_str(), sizeof name);
+        name[sizeof name - 1] = '\0';
+        utilStripDoubleExtension(name, name);
+
+        // the depth limit stops symbolic link loops
+        if (isDir && depth < 32)
+            walk(file.path, files, depth + 1);
+        else if (!isDir && (isArchive(names[i].c_str()) || imageType(name) != IMAGE_UNKNOWN))
+            files.push_back(file);
+    }
+}
+
+RomDatabase::RomDatabase()
+{
+}
+
+int RomDatabase::Scan(const char* dir, int threads)
+{
+    std::string root = dir;
+    while (root.size() > 1 && root[root.size() - 1] == FILE_SEP)
+        root.erase(root.size() - 1);
+
+    std::vector<Entry> files;
+    walk(root, files, 0);
+
+    // what is already known about the files that haven't changed
+    std::multimap<std::string, size_t> known;
+    for (size_t i = 0; i < entries.size(); i++)
+        known.insert(std::make_pair(entries[i].path, i));
+
+    std::vector<Entry> kept;
+    std::vector<Entry> pending;
+    for (size_t i = 0; i < files.size(); i++) {
+        typedef std::multimap<std::string, size_t>::iterator iter;
+        std::pair<iter, iter> range = known.equal_range(files[i].path);
+
+        bool same = range.first != range.second;
+        for (iter it = range.first; it != range.second; ++it) {
+            const Entry& e = entries[it->second];
+            same = same && e.mtime == files[i].mtime && e.fileSize == files[i].fileSize;
+        }
+
+        if (same) {
+            for (iter it = range.first; it != range.second; ++it)
+                kept.push_back(entries[it->second]);
+        } else
+            pending.push_back(files[i]);
+    }
+
+    // everything else under dir is gone or has changed
+    std::string prefix = root + FILE_SEP;
+    std::vector<Entry> rest;
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].path.compare(0, prefix.size(), prefix))
+            rest.push_back(entries[i]);
+
+    // the type tables have to be set up before there are threads about
+    fex_init();
+
+    if (threads <= 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads <= 0)
+        threads = 1;
+    if ((size_t)threads > pending.size())
+        threads = (int)pending.size();
+
+    std::vector<std::vector<Entry> > results(pending.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+
+    for (int t = 0; t < threads; t++)
+        pool.push_back(std::thread([&]() {
+            for (size_t i; (i = next++) < pending.size();)
+                scanFile(pending[i], results[i]);
+        }));
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].join();
+
+    int scanned = 0;
+    entries.swap(rest);
+    entries.insert(entries.end(), kept.begin(), kept.end());
+    for (size_t i = 0; i < results.size(); i++) {
+        entries.insert(entries.end(), results[i].begin(), results[i].end());
+        scanned += (int)results[i].size();
+    }
+
+    index();
+    return scanned;
+}
+
+void RomDatabase::index()
+{
+    byCRC.clear();
+    bySHA1.clear();
+    byCode.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        byCRC.insert(std::make_pair(entries[i].crc, i));
+        bySHA1.insert(std::make_pair(std::string((const char*)entries[i].sha1, 20), i));
+        if (!entries[i].code.empty())
+            byCode.insert(std::make_pair(entries[i].code, i));
+    }
+}
+
+std::vector<const RomDatabase::Entry*> RomDatabase::FindCRC(uint32_t crc) const
+{
+    std::vector<const Entry*> found;
+    typedef std::multimap<uint32_t, size_t>::const_iterator iter;
+    std::pair<iter, iter> range = byCRC.equal_range(crc);
+    for (iter it = range.first; it != range.second; ++it)
+        found.push_back(&entries[it->second]);
+    return found;
+}
+
+const RomDatabase::Entry* RomDatabase::FindSHA1(const uint8_t sha1[20]) const
+{
+    std::map<std::string, size_t>::const_iterator it = bySHA1.find(std::string((const char*)sha1, 20));
+    return it != bySHA1.end() ? &entries[it->second] : NULL;
+}
+
+std::vector<const RomDatabase::Entry*> RomDatabase::FindCode(const char* code) const
+{
+    std::vector<const Entry*> found;
+    typedef std::multimap<std::string, size_t>::const_iterator iter;
+    std::pair<iter, iter> range = byCode.equal_range(code);
+    for (iter it = range.first; it != range.second; ++it)
+        found.push_back(&entries[it->second]);
+    return found;
+}
+
+// the database is a text file with a line per image, the fields separated
+// by tabs:
+//   crc sha1 size type cgb sgb saveType saveSize rtc mtime fileSize
+//   code maker title path member
+bool RomDatabase::Load(const char* name)
+{
+    file = name;
+    entries.clear();
+
+    FILE* f = utilOpenFile(name, "rb");
+    if (!f) {
+        index();
+        return false;
+    }
+
+    char line[8192];
+    bool ok = fgets(line, sizeof line, f) && !strcmp(line, ROM_DATABASE_HEADER "\n");
+
+    while (ok && fgets(line, sizeof line, f)) {
+        size_t len = strlen(line);
+        if (!len || line[len - 1] != '\n')
+            break; // truncated
+        line[len - 1] = '\0';
+
+        std::vector<std::string> fields;
+        for (char *p = line, *tab; p; p = tab ? tab + 1 : NULL) {
+            tab = strchr(p, '\t');
+            fields.push_back(tab ? std::string(p, tab - p) : std::string(p));
+        }
+        if (fields.size() != 16 || fields[1].size() != 40)
+            continue;
+
+        Entry e;
+        unsigned crc;
+        int cgb, sgb, rtc;
+        long long mtime, fileSize;
+        if (sscanf(fields[0].c_str(), "%x", &crc) != 1
+            || sscanf(fields[2].c_str(), "%d", &e.size) != 1
+            || sscanf(fields[3].c_str(), "%d", &e.type) != 1
+            || sscanf(fields[4].c_str(), "%d", &cgb) != 1
+            || sscanf(fields[5].c_str(), "%d", &sgb) != 1
+            || sscanf(fields[6].c_str(), "%d", &e.saveType) != 1
+            || sscanf(fields[7].c_str(), "%d", &e.saveSize) != 1
+            || sscanf(fields[8].c_str(), "%d", &rtc) != 1
+            || sscanf(fields[9].c_str(), "%lld", &mtime) != 1
+            || sscanf(fields[10].c_str(), "%lld", &fileSize) != 1)
+            continue;
+
+        bool hex = true;
+        for (int i = 0; i < 20; i++) {
+            unsigned b;
+            hex = hex && sscanf(fields[1].c_str() + i * 2, "%2x", &b) == 1;
+            e.sha1[i] = (uint8_t)b;
+        }
+        if (!hex)
+            continue;
+
+        e.crc = crc;
+        e.cgb = cgb;
+        e.sgb = sgb != 0;
+        e.rtc = rtc != 0;
+        e.mtime = mtime;
+        e.fileSize = fileSize;
+        e.code = fields[11];
+        e.maker = fields[12];
+        e.title = fields[13];
+        e.path = fields[14];
+        e.member = fields[15];
+        entries.push_back(e);
+    }
+
+    fclose(f);
+    index();
+    return ok;
+}
+
+bool RomDatabase::Save()
+{
+    if (file.empty())
+        return false;
+
+    FILE* f = utilOpenFile(file.c_str(), "wb");
+    if (!f)
+        return false;
+
+    fprintf(f, "%s\n", ROM_DATABASE_HEADER);
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& e = entries[i];
+        if (strpbrk(e.path.c_str(), "\t\n") || strpbrk(e.member.c_str(), "\t\n"))
+            continue;
+
+        char sha1[41];
+        for (int j = 0; j < 20; j++)
+            snprintf(sha1 + j * 2, 3, "%02x", e.sha1[j]);
+
+        fprintf(f, "%08x\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%lld\t%lld\t%s\t%s\t%s\t%s\t%s\n",
+            e.crc, sha1, e.size, e.type, e.cgb, e.sgb, e.saveType, e.saveSize, e.rtc,
+            (long long)e.mtime, (long long)e.fileSize,
+            e.code.c_str(), e.maker.c_str(), e.title.c_str(), e.path.c_str(), e.member.c_str());
+    }
+
+    return !fclose(f);
+}
@@ -0,0 +1,59 @@
+#ifndef ROMDATABASE_H
+#define ROMDATABASE_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// What is known about every ROM under some directory trees: hashes, header
+// fields and the detected save type, so that a launcher can look a game up
+// by CRC, SHA-1 or game code without opening any file.  Scanning hashes the
+// files on a pool of threads and skips those whose size and modification
+// time haven't changed since they were last seen.
+class RomDatabase {
+public:
+    struct Entry {
+        std::string path;
+        std::string member; // image within an archive; empty for a plain file
+        int64_t mtime; // of path
+        int64_t fileSize; // of path
+        int type; // IMAGE_TYPE
+        int size; // of the image
+        uint32_t crc;
+        uint8_t sha1[20];
+        std::string title;
+        std::string code; // GBA game code, or CGB manufacturer code
+        std::string maker; // licensee code
+        int cgb; // CGB flag of a GB header, 0 for a DMG-only game
+        bool sgb;
+        int saveType; // GBA: as utilGBAFindSave(); GB: cartridge type byte
+        int saveSize; // GBA flash or GB cartridge RAM size, 0 if unknown
+        bool rtc;
+    };
+
+    RomDatabase();
+
+    // reads the database from file, which Save() will write back to
+    bool Load(const char* file);
+    bool Save();
+    // scans dir and everything below it; threads <= 0 uses one per core.
+    // Returns the number of images hashed.
+    int Scan(const char* dir, int threads = 0);
+
+    const std::vector<Entry>& Entries() const { return entries; }
+    std::vector<const Entry*> FindCRC(uint32_t crc) const;
+    const Entry* FindSHA1(const uint8_t sha1[20]) const;
+    std::vector<const Entry*> FindCode(const char* code) const;
+
+private:
+    std::string file;
+    std::vector<Entry> entries;
+    std::multimap<uint32_t, size_t> byCRC;
+    std::map<std::string, size_t> bySHA1;
+    std::multimap<std::string, size_t> byCode;
+
+    void index();
+};
+
+#endif // ROMDATABASE_H
@@ -0,0 +1,105 @@
+#include "../Util.h"
+#include "ScreenshotWriter.h"
+
+ScreenshotWriter::ScreenshotWriter()
+    : busy(false)
+    , stopWriter(false)
+{
+}
+
+ScreenshotWriter::~ScreenshotWriter()
+{
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopWriter = true;
+        }
+        cond.notify_all();
+        writer.join();
+    }
+
+    for (size_t i = 0; i < pool.size(); i++)
+        delete pool[i];
+}
+
+void ScreenshotWriter::Capture(const char* fileName, int w, int h, uint8_t* pix, bool png, int level)
+{
+    Job* job = NULL;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (!pool.empty()) {
+            job = pool.back();
+            pool.pop_back();
+        }
+    }
+
+    if (!job)
+        job = new Job;
+
+    job->fileName = fileName;
+    job->w = w;
+    job->h = h;
+    job->png = png;
+    job->level = level;
+    job->rgb.resize(w * h * 3);
+    utilPixToRGB(pix, w, h, &job->rgb[0]);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(job);
+    }
+
+    if (!writer.joinable())
+        writer = std::thread(&ScreenshotWriter::run_writer, this);
+
+    cond.notify_all();
+}
+
+void ScreenshotWriter::Flush()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (!queue.empty() || busy)
+        cond.wait(guard);
+}
+
+std::vector<std::string> ScreenshotWriter::TakeFailures()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::string> ret;
+    ret.swap(failures);
+    return ret;
+}
+
+void ScreenshotWriter::run_writer()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    for (;;) {
+        while (queue.empty() && !stopWriter)
+            cond.wait(guard);
+
+        // finish the queue even when stopping
+        if (queue.empty())
+            break;
+
+        Job* job = queue.front();
+        queue.pop_front();
+        busy = true;
+        guard.unlock();
+
+        bool ok = job->png ? utilWriteRGBPNGFile(job->fileName.c_str(), job->w, job->h, &job->rgb[0], job->level)
+                           : utilWriteRGBBMPFile(job->fileName.c_str(), job->w, job->h, &job->rgb[0]);
+
+        guard.lock();
+        busy = false;
+
+        if (!ok)
+            failures.push_back(job->fileName);
+
+        pool.push_back(job);
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef SCREENSHOTWRITER_H
+#define SCREENSHOTWRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes screen captures without holding up the emulation thread.
+// Capture() only converts the frame buffer into a pooled RGB buffer; a
+// writer thread encodes and saves it.  Nothing queued is ever dropped, so
+// every frame of a burst ends up on disk, just later.
+class ScreenshotWriter {
+public:
+    ScreenshotWriter();
+    ~ScreenshotWriter();
+
+    // pix is the emulator's frame buffer, w x h the visible screen;
+    // level is the PNG compression level (0-9), ignored for BMP
+    void Capture(const char* fileName, int w, int h, uint8_t* pix, bool png, int level);
+    // wait until everything queued has been written
+    void Flush();
+    // captures that could not be written since the last call
+    std::vector<std::string> TakeFailures();
+
+private:
+    struct Job {
+        std::string fileName;
+        int w, h;
+        bool png;
+        int level;
+        std::vector<uint8_t> rgb;
+    };
+
+    std::deque<Job*> queue;
+    std::vector<Job*> pool;
+    std::vector<std::string> failures;
+    bool busy;
+    bool stopWriter;
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable cond;
+
+    void run_writer();
+};
+
+#endif // SCREENSHOTWRITER_H
@@ -3,6 +3,10 @@
 #define STREAM_FRAME_RATE 60
 #define STREAM_PIXEL_FORMAT AV_PIX_FMT_YUV420P
 #define IN_SOUND_FORMAT AV_SAMPLE_FMT_S16
+// frames that may wait for the encoder thread before video is dropped
+// and audio blocks
+#define VIDEO_QUEUE_FRAMES 16
+#define AUDIO_QUEUE_FRAMES 64
 
 struct supportedCodecs {
     AVCodecID codecId;
@@ -288,6 +292,8 @@ recording::MediaRet recording::MediaRecorder::setup_video_stream(int width, int
     frameOut->width  = width;
     frameOut->height = height;
     if (av_frame_get_buffer(frameOut, 32) < 0) return MRET_ERR_NOMEM;
+    // bytes copied out of the emulator's frame; top border skipped
+    frameBytes = (size_t)height * (width + rbord) * pixsize;
     return MRET_OK;
 }
 
@@ -331,6 +337,11 @@ recording::MediaRecorder::MediaRecorder() : isRecording(false),
     posInAudioBuffer = 0;
     samplesInAudioBuffer = 0;
     audioBufferSize = 0;
+    // encoder thread
+    stopEncoder = false;
+    encoderRet = MRET_OK;
+    stats = MediaStats();
+    frameBytes = 0;
 }
 
 // video : return error code to user
@@ -373,12 +384,20 @@ recording::MediaRet recording::MediaRecorder::Record(const char *fname, int widt
         Stop();
         return ret;
     }
+    start_encoder();
     return MRET_OK;
 }
 
 recording::MediaRet recording::MediaRecorder::AddFrame(const uint8_t *vid)
 {
     if (!isRecording) return MRET_OK;
+    // a dropped frame still uses up its pts, so audio stays in sync
+    return queue_frame(true, vid + tbord * (linesize + pixsize * rbord),
+                       frameBytes, npts++);
+}
+
+recording::MediaRet recording::MediaRecorder::encode_video(const uint8_t *vid, int64_t pts)
+{
     // fill and encode frame variables
     int got_packet = 0, ret = 0;
     AVPacket pkt;
@@ -387,15 +406,14 @@ recording::MediaRet recording::MediaRecorder::AddFrame(const uint8_t *vid)
     pkt.size = 0;
     // fill frame with current pic
     ret = av_image_fill_arrays(frameIn->data, frameIn->linesize,
-                               (uint8_t *)vid + tbord * (linesize + pixsize * rbord),
-                               pixfmt, enc->width + rbord, enc->height, 1);
+                               (uint8_t *)vid, pixfmt, enc->width + rbord, enc->height, 1);
     if (ret < 0) return MRET_ERR_RECORDING;
     // convert from input format to output
     sws_scale(sws, (const uint8_t * const *) frameIn->data,
               frameIn->linesize, 0, enc->height, frameOut->data,
               frameOut->linesize);
     // set valid pts for frame
-    frameOut->pts = npts++;
+    frameOut->pts = pts;
     // finally, encode frame
     got_packet = avcodec_receive_packet(enc, &pkt);
     ret = avcodec_send_frame(enc, frameOut);
@@ -415,6 +433,8 @@ recording::MediaRet recording::MediaRecorder::AddFrame(const uint8_t *vid)
 
 void recording::MediaRecorder::Stop()
 {
+    // let the encoder drain its queue first
+    stop_encoder();
     if (oc)
     {
         // write the trailer; must be called before av_codec_close()
@@ -542,6 +562,7 @@ recording::MediaRet recording::MediaRecorder::Record(const char *fname)
         Stop();
         return ret;
     }
+    start_encoder();
     return MRET_OK;
 }
 
@@ -550,6 +571,11 @@ recording::MediaRet recording::MediaRecorder::Record(const char *fname)
 recording::MediaRet recording::MediaRecorder::AddFrame(const uint16_t *aud, int length)
 {
     if (!isRecording) return MRET_OK;
+    return queue_frame(false, aud, length, 0);
+}
+
+recording::MediaRet recording::MediaRecorder::encode_audio(const uint16_t *aud, int length)
+{
     AVCodecContext *c = aenc;
     int samples_size = av_samples_get_buffer_size(NULL, c->channels, audioframeTmp->nb_samples, IN_SOUND_FORMAT, 1);
 
@@ -651,3 +677,136 @@ void recording::MediaRecorder::flush_frames()
     while (avcodec_receive_packet(aenc, &pkt) >= 0)
         avcodec_send_frame(aenc, NULL);
 }
+
+// the encoder thread owns the codecs and the output file between
+// start_encoder() and stop_encoder(); the emulator only copies frames
+// into the preallocated pool and queues them
+void recording::MediaRecorder::start_encoder()
+{
+    size_t nvideo = audioOnlyRecording ? 0 : VIDEO_QUEUE_FRAMES;
+    // 1/60th of a second of stereo audio, rounded up
+    size_t audioBytes = (sampleRate / STREAM_FRAME_RATE + 1) * 2 * sizeof(uint16_t);
+    pool.resize(nvideo + AUDIO_QUEUE_FRAMES);
+    for (size_t i = 0; i < pool.size(); ++i)
+    {
+        QueuedFrame *f = &pool[i];
+        f->video = i < nvideo;
+        if (f->video)
+        {
+            f->data.resize(frameBytes);
+            freeVideo.push_back(f);
+        }
+        else
+        {
+            f->data.reserve(audioBytes);
+            freeAudio.push_back(f);
+        }
+    }
+    stats = MediaStats();
+    encoderRet = MRET_OK;
+    stopEncoder = false;
+    encoder = std::thread(&MediaRecorder::run_encoder, this);
+}
+
+void recording::MediaRecorder::stop_encoder()
+{
+    if (!encoder.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        stopEncoder = true;
+    }
+    queueCond.notify_one();
+    encoder.join();
+    queue.clear();
+    freeVideo.clear();
+    freeAudio.clear();
+    pool.clear();
+}
+
+void recording::MediaRecorder::run_encoder()
+{
+    std::unique_lock<std::mutex> lock(queueLock);
+    for (;;)
+    {
+        while (queue.empty() && !stopEncoder)
+            queueCond.wait(lock);
+        if (queue.empty())
+            break;
+        QueuedFrame *f = queue.front();
+        queue.pop_front();
+        // after an error, keep draining but stop feeding the codecs
+        bool failed = encoderRet != MRET_OK;
+        lock.unlock();
+        MediaRet ret = MRET_OK;
+        if (!failed)
+        {
+            if (f->video)
+                ret = encode_video(f->data.data(), f->pts);
+            else
+                ret = encode_audio((const uint16_t *)f->data.data(), (int)f->data.size());
+        }
+        lock.lock();
+        if (ret != MRET_OK && encoderRet == MRET_OK)
+            encoderRet = ret;
+        if (f->video)
+            freeVideo.push_back(f);
+        else
+        {
+            freeAudio.push_back(f);
+            freeCond.notify_one();
+        }
+    }
+}
+
+recording::MediaRet recording::MediaRecorder::queue_frame(bool video, const void *data, size_t size, int64_t pts)
+{
+    QueuedFrame *f;
+    {
+        std::unique_lock<std::mutex> lock(queueLock);
+        // report encoder errors back to the caller
+        if (encoderRet != MRET_OK)
+            return encoderRet;
+        if (video && freeVideo.empty())
+        {
+            ++stats.droppedVideo;
+            return MRET_OK;
+        }
+        // audio pts are derived from the samples encoded so far, so a
+        // dropped audio frame would pull all later audio ahead of the video
+        if (!video && freeAudio.empty())
+        {
+            ++stats.stalledAudio;
+            while (freeAudio.empty())
+                freeCond.wait(lock);
+        }
+        std::vector<QueuedFrame *> &freeList = video ? freeVideo : freeAudio;
+        f = freeList.back();
+        freeList.pop_back();
+    }
+    // copy outside the lock so the encoder is never held up by it; audio
+    // buffers are reserved for 1/60th of a second and only grow if the
+    // sample rate goes up while recording
+    f->pts = pts;
+    if (!video)
+        f->data.resize(size);
+    memcpy(f->data.data(), data, size);
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        queue.push_back(f);
+        if (queue.size() > stats.maxQueued)
+            stats.maxQueued = (unsigned)queue.size();
+        if (video)
+            ++stats.videoFrames;
+        else
+            ++stats.audioFrames;
+    }
+    queueCond.notify_one();
+    return MRET_OK;
+}
+
+recording::MediaStats recording::MediaRecorder::GetStats()
+{
+    std::lock_guard<std::mutex> lock(queueLock);
+    return stats;
+}
@@ -31,6 +31,10 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
@@ -55,6 +59,15 @@ enum MediaRet {
         MRET_ERR_BUFSIZE    // buffer overflow (fatal)
 };
 
+// encoder queue counters; kept after Stop() until the next Record()
+struct MediaStats {
+        unsigned videoFrames;  // video frames queued for encoding
+        unsigned audioFrames;  // audio frames queued for encoding
+        unsigned droppedVideo; // video frames dropped because the queue was full
+        unsigned stalledAudio; // audio frames that had to wait for the encoder
+        unsigned maxQueued;    // deepest the queue got
+};
+
 class MediaRecorder
 {
         public:
@@ -85,6 +98,11 @@ class MediaRecorder
         {
                 sampleRate = newSampleRate;
         }
+        // frames are copied into a fixed pool of buffers and encoded on
+        // a separate thread; when the pool runs dry video frames are
+        // dropped, while audio waits for the encoder, as its timestamps
+        // come from the number of samples written
+        MediaStats GetStats();
 
         private:
         bool isRecording;
@@ -117,6 +135,23 @@ class MediaRecorder
         int posInAudioBuffer;
         int samplesInAudioBuffer;
         int audioBufferSize;
+        // encoder thread and the queue feeding it
+        struct QueuedFrame {
+                bool video;
+                int64_t pts;
+                std::vector<uint8_t> data;
+        };
+        std::thread encoder;
+        std::mutex queueLock;
+        std::condition_variable queueCond;
+        std::condition_variable freeCond; // an audio buffer was returned
+        std::deque<QueuedFrame *> queue;
+        std::vector<QueuedFrame *> freeVideo, freeAudio;
+        std::vector<QueuedFrame> pool;
+        bool stopEncoder;
+        MediaRet encoderRet;
+        MediaStats stats;
+        size_t frameBytes;
 
         MediaRet setup_common(const char *fname);
         MediaRet setup_video_stream_info(int width, int height, int depth);
@@ -126,6 +161,12 @@ class MediaRecorder
         // flush last frames to avoid
         // "X frames left in the queue on closing"
         void flush_frames();
+        void start_encoder();
+        void stop_encoder();
+        void run_encoder();
+        MediaRet queue_frame(bool video, const void *data, size_t size, int64_t pts);
+        MediaRet encode_video(const uint8_t *vid, int64_t pts);
+        MediaRet encode_audio(const uint16_t *aud, int length);
 };
 
 }
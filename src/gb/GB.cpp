@@ -23,6 +23,13 @@
 #define _stricmp strcasecmp
 #endif
 
+// The opcodes in gbCodes.h/gbCodesCB.h are dispatched through a computed goto
+// table when the compiler supports it. Define NO_GB_THREADED_DISPATCH to use
+// the plain switch instead, e.g. when bisecting an accuracy regression.
+#if defined(__GNUC__) && !defined(NO_GB_THREADED_DISPATCH)
+#define GB_THREADED_DISPATCH
+#endif
+
 extern uint8_t* pix;
 bool gbUpdateSizes();
 bool inBios = false;
@@ -39,6 +46,14 @@ void (*mapperRAM)(uint16_t, uint8_t) = NULL;
 uint8_t (*mapperReadRAM)(uint16_t) = NULL;
 void (*mapperUpdateClock)() = NULL;
 
+// Per 256 byte page access flags, indexed by address >> 8. Flagged pages
+// are plain ROM/WRAM that can be accessed straight through gbMemoryMap.
+// gbMemoryMap already follows the mapper bank switches, so this only needs
+// rebuilding when the cheat map changes.
+#define GB_PAGE_READ 1
+#define GB_PAGE_WRITE 2
+static uint8_t gbMemoryPages[0x100];
+
 // registers
 gbRegister PC;
 gbRegister SP;
@@ -976,8 +991,30 @@ void gbCompareLYToLYC()
     }
 }
 
+void gbUpdateMemoryPages()
+{
+    for (int page = 0; page < 0x100; page++) {
+        uint8_t flags = 0;
+
+        if (page < 0x80)
+            flags = GB_PAGE_READ;
+        else if (page >= 0xc0 && page < 0xe0)
+            flags = GB_PAGE_READ | GB_PAGE_WRITE;
+
+        // cheat patched pages have to go through gbCheatRead
+        if (gbCheatPages[page])
+            flags &= ~GB_PAGE_READ;
+
+        gbMemoryPages[page] = flags;
+    }
+}
+
 void gbWriteMemory(uint16_t address, uint8_t value)
 {
+    if (gbMemoryPages[address >> 8] & GB_PAGE_WRITE) {
+        gbMemoryMap[address >> 12][address & 0x0fff] = value;
+        return;
+    }
 
     if (address < 0x8000) {
 #ifndef FINAL_VERSION
@@ -1032,6 +1069,7 @@ void gbWriteMemory(uint16_t address, uint8_t value)
             return;
         else {
             gbMemory[address] = value;
+            gbSpriteListDirty = true;
             return;
         }
     }
@@ -1457,6 +1495,7 @@ void gbWriteMemory(uint16_t address, uint8_t value)
         gbCopyMemory(0xfe00,
             source,
             0xa0);
+        gbSpriteListDirty = true;
         gbMemory[0xff46] = register_DMA = value;
         return;
     }
@@ -1796,8 +1835,14 @@ void gbWriteMemory(uint16_t address, uint8_t value)
 
 uint8_t gbReadMemory(uint16_t address)
 {
-    if (gbCheatMap[address])
-        return gbCheatRead(address);
+    if (gbMemoryPages[address >> 8] & GB_PAGE_READ)
+        return gbMemoryMap[address >> 12][address & 0x0fff];
+
+    if (gbCheatPages[address >> 8]) {
+        int value = gbCheatRead(address);
+        if (value >= 0)
+            return value;
+    }
 
     if (address < 0x8000)
         return gbMemoryMap[address >> 12][address & 0x0fff];
@@ -2315,6 +2360,8 @@ static void gbSelectColorizationPalette()
 
 void gbReset()
 {
+    gbUpdateMemoryPages();
+
 #ifndef NO_LINK
     if (GetLinkMode() == LINK_GAMEBOY_IPC || GetLinkMode() == LINK_GAMEBOY_SOCKET) {
         EmuReseted = true;
@@ -2417,6 +2464,7 @@ void gbReset()
         memset(gbObp1Line, 0x0, sizeof(gbObp1Line));
     }
     memset(gbSpritesTicks, 0x0, sizeof(gbSpritesTicks));
+    gbSpriteListDirty = true;
 
     SP.W = 0xfffe;
     AF.W = 0x01b0;
@@ -3401,6 +3449,27 @@ bool gbWriteBatteryFile(const char* file)
         return false;
 }
 
+// battery RAM, for mappers whose battery file is nothing but a dump
+// of it; the others also save clock data and are written in full
+uint8_t* gbBatteryData(int& size)
+{
+    if (!gbBattery || gbBatteryError || !gbRam)
+        return NULL;
+
+    switch (gbRomType) {
+    case 0x03:
+    case 0x13:
+    case 0x1b:
+    case 0x1e:
+    case 0xfc:
+    case 0xff:
+        size = gbRamSizeMask + 1;
+        return gbRam;
+    }
+
+    return NULL;
+}
+
 bool gbReadBatteryFile(const char* file)
 {
     bool res = false;
@@ -3857,6 +3926,7 @@ static bool gbReadSaveState(gzFile gzFile)
     memset(gbObp0Line, (gbObp0[0] | (gbObp0[1] << 2) | (gbObp0[2] << 4) | (gbObp0[3] << 6)), sizeof(gbObp0Line));
     memset(gbObp1Line, (gbObp1[0] | (gbObp1[1] << 2) | (gbObp1[2] << 4) | (gbObp1[3] << 6)), sizeof(gbObp1Line));
     memset(gbSpritesTicks, 0x0, sizeof(gbSpritesTicks));
+    gbSpriteListDirty = true;
 
     if (inBios) {
         gbMemoryMap[0x00] = &gbMemory[0x0000];
@@ -4473,6 +4543,15 @@ int gbGetNextEvent(int _clockTicks)
 
 void gbDrawLine()
 {
+#ifdef __LIBRETRO__
+    // the LCD off fill runs one line past the screen, which has no room
+    // for it without the border
+    if (register_LY >= 144 && !gbBorderOn)
+        return;
+
+    systemLineDrawn(register_LY, gbLineMix, sizeof(gbLineMix));
+#endif
+
     switch (systemColorDepth) {
     case 16: {
 #ifdef __LIBRETRO__
@@ -4867,6 +4946,9 @@ void gbEmulate(int ticksToStop)
 
                         gbLcdMode = 2;
                         register_LY = 0x00;
+                        // OAM may have been edited outside the core (memory
+                        // viewer, frontends) since the last frame
+                        gbSpriteListDirty = true;
 
                     } break;
                     case 2: {
@@ -5380,6 +5462,47 @@ void gbEmulate(int ticksToStop)
 
         // Executes the opcode(s), and apply the instruction's remaining clockTicks (if any).
         if (execute) {
+#ifdef GB_THREADED_DISPATCH
+#define GB_OPCODE_ROW(p, r)                                                   \
+    &&p##r##0, &&p##r##1, &&p##r##2, &&p##r##3, &&p##r##4, &&p##r##5,         \
+        &&p##r##6, &&p##r##7, &&p##r##8, &&p##r##9, &&p##r##a, &&p##r##b,     \
+        &&p##r##c, &&p##r##d, &&p##r##e, &&p##r##f
+#define GB_OPCODE_TABLE(p)                                                    \
+    GB_OPCODE_ROW(p, 0x0), GB_OPCODE_ROW(p, 0x1), GB_OPCODE_ROW(p, 0x2),      \
+        GB_OPCODE_ROW(p, 0x3), GB_OPCODE_ROW(p, 0x4), GB_OPCODE_ROW(p, 0x5),  \
+        GB_OPCODE_ROW(p, 0x6), GB_OPCODE_ROW(p, 0x7), GB_OPCODE_ROW(p, 0x8),  \
+        GB_OPCODE_ROW(p, 0x9), GB_OPCODE_ROW(p, 0xa), GB_OPCODE_ROW(p, 0xb),  \
+        GB_OPCODE_ROW(p, 0xc), GB_OPCODE_ROW(p, 0xd), GB_OPCODE_ROW(p, 0xe),  \
+        GB_OPCODE_ROW(p, 0xf)
+            static const void* const gbOpcodeTable[256] = { GB_OPCODE_TABLE(gbOpcode_) };
+            static const void* const gbOpcodeTableCB[256] = { GB_OPCODE_TABLE(gbOpcodeCB_) };
+#undef GB_OPCODE_TABLE
+#undef GB_OPCODE_ROW
+
+#define GB_OPCODE_END goto gbOpcodeDone;
+            goto* gbOpcodeTable[opcode1];
+
+        gbOpcode_0xcb:
+            // extended opcode
+            goto* gbOpcodeTableCB[opcode2];
+
+#define GB_OPCODE(n) gbOpcodeCB_##n:
+#define GB_OPCODE_DEFAULT gbOpcodeCB_default : __attribute__((unused));
+#include "gbCodesCB.h"
+#undef GB_OPCODE_DEFAULT
+#undef GB_OPCODE
+
+#define GB_OPCODE(n) gbOpcode_##n:
+#define GB_OPCODE_DEFAULT gbOpcode_default : __attribute__((unused));
+#include "gbCodes.h"
+#undef GB_OPCODE_DEFAULT
+#undef GB_OPCODE
+
+        gbOpcodeDone:
+#else
+#define GB_OPCODE(n) case n:
+#define GB_OPCODE_END break;
+#define GB_OPCODE_DEFAULT default:
             switch (opcode1) {
             case 0xCB:
                 // extended opcode
@@ -5389,6 +5512,10 @@ void gbEmulate(int ticksToStop)
                 break;
 #include "gbCodes.h"
             }
+#undef GB_OPCODE_DEFAULT
+#undef GB_OPCODE
+#endif
+#undef GB_OPCODE_END
             execute = false;
 
             if (clockTicks) {
@@ -5658,6 +5785,7 @@ bool gbReadSaveState(const uint8_t* data, unsigned)
     memset(gbObp0Line, (gbObp0[0] | (gbObp0[1] << 2) | (gbObp0[2] << 4) | (gbObp0[3] << 6)), sizeof(gbObp0Line));
     memset(gbObp1Line, (gbObp1[0] | (gbObp1[1] << 2) | (gbObp1[2] << 4) | (gbObp1[3] << 6)), sizeof(gbObp1Line));
     memset(gbSpritesTicks, 0x0, sizeof(gbSpritesTicks));
+    gbSpriteListDirty = true;
 
     if (inBios) {
         gbMemoryMap[0x00] = &gbMemory[0x0000];
@@ -30,6 +30,7 @@ bool gbLoadRom(const char*);
 bool gbUpdateSizes();
 void gbEmulate(int);
 void gbWriteMemory(uint16_t, uint8_t);
+void gbUpdateMemoryPages();
 void gbDrawLine();
 bool gbIsGameboyRom(const char*);
 void gbGetHardwareType();
@@ -46,6 +47,7 @@ bool gbReadSaveState(const char*);
 bool gbWriteBatteryFile(const char*);
 bool gbWriteBatteryFile(const char*, bool);
 bool gbReadBatteryFile(const char*);
+uint8_t* gbBatteryData(int& size);
 bool gbWriteMemSaveState(char*, int, long&);
 bool gbReadMemSaveState(char*, int);
 void gbSgbRenderBorder();
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,19 +16,46 @@
 gbCheat gbCheatList[MAX_CHEATS];
 int gbCheatNumber = 0;
 int gbNextCheat = 0;
-bool gbCheatMap[0x10000];
+
+// Enabled Game Genie codes, the ones that change what is read, by address:
+// a flag for each 256 byte page with any, and for each page its codes
+// sorted by address, in list order for the same address.
+uint8_t gbCheatPages[0x100];
+static int gbCheatPageStart[0x101];
+static uint16_t gbCheatIndex[MAX_CHEATS];
 
 #define GBCHEAT_IS_HEX(a) (((a) >= 'A' && (a) <= 'F') || ((a) >= '0' && (a) <= '9'))
 #define GBCHEAT_HEX_VALUE(a) ((a) >= 'A' ? (a) - 'A' + 10 : (a) - '0')
 
+static bool gbCheatAddressLess(uint16_t a, uint16_t b)
+{
+    return gbCheatList[a].address < gbCheatList[b].address;
+}
+
 void gbCheatUpdateMap()
 {
-    memset(gbCheatMap, 0, 0x10000);
+    int count = 0;
+
+    memset(gbCheatPages, 0, sizeof(gbCheatPages));
 
     for (int i = 0; i < gbCheatNumber; i++) {
-        if (gbCheatList[i].enabled)
-            gbCheatMap[gbCheatList[i].address] = true;
+        if (gbCheatList[i].enabled && (gbCheatList[i].code == 0x100 || gbCheatList[i].code == 0x101)) {
+            gbCheatIndex[count++] = i;
+            gbCheatPages[gbCheatList[i].address >> 8] = 1;
+        }
     }
+
+    std::stable_sort(gbCheatIndex, gbCheatIndex + count, gbCheatAddressLess);
+
+    int page = 0;
+    for (int i = 0; i < count; i++) {
+        while (page <= (gbCheatList[gbCheatIndex[i]].address >> 8))
+            gbCheatPageStart[page++] = i;
+    }
+    while (page <= 0x100)
+        gbCheatPageStart[page++] = count;
+
+    gbUpdateMemoryPages();
 }
 
 #ifndef __LIBRETRO__
@@ -344,10 +372,10 @@ bool gbAddGgCheat(const char* code, const char* desc)
 
     gbCheatList[i].enabled = true;
 
-    gbCheatMap[gbCheatList[i].address] = true;
-
     gbCheatNumber++;
 
+    gbCheatUpdateMap();
+
     return true;
 }
 
@@ -431,23 +459,36 @@ bool gbCheatReadGSCodeFile(const char* fileName)
     return true;
 }
 
-// Used to emulated GG codes
-uint8_t gbCheatRead(uint16_t address)
+// Used to emulated GG codes; -1 if there is no code for the address
+int gbCheatRead(uint16_t address)
 {
     if (!cheatsEnabled)
-        return gbMemoryMap[address >> 12][address & 0xFFF];
+        return -1;
+
+    int lo = gbCheatPageStart[address >> 8];
+    int end = gbCheatPageStart[(address >> 8) + 1];
+    int hi = end;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (gbCheatList[gbCheatIndex[mid]].address < address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-    for (int i = 0; i < gbCheatNumber; i++) {
-        if (gbCheatList[i].enabled && gbCheatList[i].address == address) {
-            switch (gbCheatList[i].code) {
-            case 0x100: // GameGenie support
-                if (gbMemoryMap[address >> 12][address & 0xFFF] == gbCheatList[i].compare)
-                    return gbCheatList[i].value;
-                break;
-            case 0x101: // GameGenie 6 digits code support
-                return gbCheatList[i].value;
-                break;
-            }
+    if (lo == end || gbCheatList[gbCheatIndex[lo]].address != address)
+        return -1;
+
+    for (; lo < end && gbCheatList[gbCheatIndex[lo]].address == address; lo++) {
+        const gbCheat& cheat = gbCheatList[gbCheatIndex[lo]];
+        switch (cheat.code) {
+        case 0x100: // GameGenie support
+            if (gbMemoryMap[address >> 12][address & 0xFFF] == cheat.compare)
+                return cheat.value;
+            break;
+        case 0x101: // GameGenie 6 digits code support
+            return cheat.value;
         }
     }
     return gbMemoryMap[address >> 12][address & 0xFFF];
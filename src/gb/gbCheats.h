@@ -34,13 +34,13 @@ void gbCheatRemove(int);
 void gbCheatRemoveAll();
 void gbCheatEnable(int);
 void gbCheatDisable(int);
-uint8_t gbCheatRead(uint16_t);
+int gbCheatRead(uint16_t);
 void gbCheatWrite(bool);
 bool gbVerifyGsCode(const char* code);
 bool gbVerifyGgCode(const char* code);
 
 extern int gbCheatNumber;
 extern gbCheat gbCheatList[MAX_CHEATS];
-extern bool gbCheatMap[0x10000];
+extern uint8_t gbCheatPages[0x100];
 
 #endif // GBCHEATS_H
@@ -44,9 +44,35 @@ uint16_t gbWindowColor[160];
 extern int inUseRegister_WY;
 extern int layerSettings;
 
+// Computes the final colours of the four pixel values of a BG/window tile.
+// Only valid when the DMG palette did not change during the line and no SGB
+// attribute file is in use, as both of those are resolved per pixel.
+static inline void gbTileColors(uint16_t* colors, uint8_t attrs, uint8_t bgp)
+{
+    for (int c = 0; c < 4; c++) {
+        int p;
+
+        if (gbCgbMode) {
+            // Use the DMG palette if we are in compat mode.
+            if (gbMemory[0xff6c] & 1)
+                p = gbBgp[c];
+            else
+                p = c + (attrs & 7) * 4;
+        } else
+            p = (bgp >> (c << 1)) & 3;
+
+        colors[c] = gbColorOption ? gbColorFilter[gbPalette[p] & 0x7FFF] : gbPalette[p] & 0x7FFF;
+    }
+}
+
 void gbRenderLine()
 {
     memset(gbLineMix, 0, sizeof(gbLineMix));
+
+    // When BGP was not written during the line every tile can be drawn from
+    // four precomputed colours instead of resolving the palette per pixel.
+    bool tileColors = gbCgbMode || (!gbSgbMode && !memcmp(gbBgpLine, gbBgpLine + 1, sizeof(gbBgpLine) - 1));
+    uint16_t colors[4];
     uint8_t* bank0;
     uint8_t* bank1;
     if (gbCgbMode) {
@@ -127,6 +153,23 @@ void gbRenderLine()
                     tile_b = gbInvertTab[tile_b];
                 }
 
+                if (tileColors) {
+                    uint16_t priority = (attrs & 0x80) ? 0x300 : 0;
+
+                    gbTileColors(colors, attrs, gbBgpLine[0]);
+                    while (bx > 0) {
+                        uint8_t c = ((tile_a & bx) ? 1 : 0) | ((tile_b & bx) ? 2 : 0);
+
+                        gbLineBuffer[x] = priority | c;
+                        gbLineMix[x] = colors[c];
+                        x++;
+                        if (x >= 160)
+                            break;
+                        bx >>= 1;
+                    }
+                    bx = 0;
+                }
+
                 while (bx > 0) {
                     uint8_t c = (tile_a & bx) ? 1 : 0;
                     c += ((tile_b & bx) ? 2 : 0);
@@ -317,6 +360,25 @@ void gbRenderLine()
                             tile_b = gbInvertTab[tile_b];
                         }
 
+                        if (tileColors) {
+                            uint16_t priority = (attrs & 0x80) ? 0x300 : 0x100;
+
+                            gbTileColors(colors, attrs, gbBgpLine[0]);
+                            while (bx > 0) {
+                                uint8_t c = ((tile_a & bx) ? 1 : 0) | ((tile_b & bx) ? 2 : 0);
+
+                                if (x >= 0) {
+                                    gbLineBuffer[x] = priority + c;
+                                    gbLineMix[x] = colors[c];
+                                }
+                                x++;
+                                if (x >= 160)
+                                    break;
+                                bx >>= 1;
+                            }
+                            bx = 0;
+                        }
+
                         while (bx > 0) {
                             uint8_t c = (tile_a & bx) != 0 ? 1 : 0;
                             c += ((tile_b & bx) != 0 ? 2 : 0);
@@ -522,6 +584,37 @@ void gbDrawSpriteTile(int tile, int x, int y, int t, int flags,
     }
 }
 
+// The sprites gbDrawSprites picks on each line: the first ten in OAM order
+// that are on screen and intersect it.  Rebuilt from OAM when it was
+// written or the sprite size changed, instead of scanning all 40 entries
+// twice per line.
+static uint8_t gbSpriteLine[160][10];
+static uint8_t gbSpriteLineCount[160];
+static int gbSpriteListSize;
+bool gbSpriteListDirty = true;
+
+static void gbBuildSpriteList(int size)
+{
+    int height = size ? 16 : 8;
+
+    memset(gbSpriteLineCount, 0, sizeof(gbSpriteLineCount));
+
+    for (int i = 0; i < 40; i++) {
+        int y = gbMemory[0xfe00 + 4 * i];
+        int x = gbMemory[0xfe00 + 4 * i + 1];
+
+        if (x > 0 && y > 0 && x < 168 && y < 160) {
+            for (int line = y - 16; line < y - 16 + height; line++) {
+                if (line >= 0 && gbSpriteLineCount[line] < 10)
+                    gbSpriteLine[line][gbSpriteLineCount[line]++] = i;
+            }
+        }
+    }
+
+    gbSpriteListSize = size;
+    gbSpriteListDirty = false;
+}
+
 void gbDrawSprites(bool draw)
 {
     int x = 0;
@@ -539,8 +632,18 @@ void gbDrawSprites(bool draw)
     if ((register_LCDC & 2) && (layerSettings & 0x1000)) {
         int yc = register_LY;
 
-        int address = 0xfe00;
-        for (int i = 0; i < 40; i++) {
+        if (yc >= 160)
+            return;
+
+        if (gbSpriteListDirty || gbSpriteListSize != size)
+            gbBuildSpriteList(size);
+
+        // mode 3 is lengthened from each sprite's X on; summed up below
+        uint8_t ticks[300] = { 0 };
+
+        for (int n = 0; n < gbSpriteLineCount[yc]; n++) {
+            int i = gbSpriteLine[yc][n];
+            int address = 0xfe00 + 4 * i;
             y = gbMemory[address++];
             x = gbMemory[address++];
             int tile = gbMemory[address++];
@@ -548,27 +651,20 @@ void gbDrawSprites(bool draw)
                 tile &= 254;
             int flags = gbMemory[address++];
 
-            if (x > 0 && y > 0 && x < 168 && y < 160) {
-                // check if sprite intersects current line
-                int t = yc - y + 16;
-                if ((size && t >= 0 && t < 16) || (!size && t >= 0 && t < 8)) {
-                    if (draw)
-                        gbDrawSpriteTile(tile, x - 8, yc, t, flags, size, i);
-                    else {
-                        for (int j = x - 8; j < 300; j++)
-                            if (j >= 0) {
-                                if (gbSpeed)
-                                    gbSpritesTicks[j] += 5;
-                                else
-                                    gbSpritesTicks[j] += 2 + (count & 1);
-                            }
-                    }
-                    count++;
-                }
+            int t = yc - y + 16;
+            if (draw)
+                gbDrawSpriteTile(tile, x - 8, yc, t, flags, size, i);
+            else
+                ticks[x < 8 ? 0 : x - 8] += gbSpeed ? 5 : 2 + (count & 1);
+            count++;
+        }
+
+        if (!draw && count) {
+            int sum = 0;
+            for (int j = 0; j < 300; j++) {
+                sum += ticks[j];
+                gbSpritesTicks[j] = sum;
             }
-            // sprite limit reached!
-            if (count >= 10)
-                break;
         }
     }
     return;
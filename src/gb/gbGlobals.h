@@ -69,6 +69,8 @@ extern int gbDmaTicks;
 
 extern void gbRenderLine();
 extern void gbDrawSprites(bool);
+// set whenever OAM is written, so that gbDrawSprites rebuilds its lists
+extern bool gbSpriteListDirty;
 
 extern uint8_t (*gbSerialFunction)(uint8_t);
 
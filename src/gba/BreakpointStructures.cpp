@@ -95,10 +95,12 @@ w, word, uint2_t                        --> word
 sw, sword, int32_t, int                 --> signed word
 */
 
+#include <algorithm>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 #include "BreakpointStructures.h"
 #include "remote.h"
@@ -107,8 +109,6 @@ sw, sword, int32_t, int                 --> signed word
 #define strdup _strdup
 #endif
 
-extern bool dexp_eval(char*, uint32_t*);
-
 //struct intToString{
 //	int value;
 //	char mapping[20];
@@ -116,6 +116,25 @@ extern bool dexp_eval(char*, uint32_t*);
 
 struct ConditionalBreak* conditionals[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
+// Unconditional watchpoints covering whole ranges (what GDB asks for) are
+// kept as intervals, sorted by start, instead of one ConditionalBreak per
+// byte. breakRangesMaxEnd[i][n] is the highest end among the first n+1
+// ranges, so a lookup only walks back over ranges that can still cover
+// the address.
+struct BreakRange {
+    uint32_t start;
+    uint32_t end; // inclusive
+    uint8_t flags;
+};
+
+static std::vector<BreakRange> breakRanges[16];
+static std::vector<uint32_t> breakRangesMaxEnd[16];
+
+// Sorted copy of the conditionals lists for lookups from the CPU loop,
+// rebuilt on the first lookup after any of the lists changed.
+static std::vector<struct ConditionalBreak*> conditionalIndex[16];
+static bool conditionalIndexDirty = true;
+
 //struct intToString breakFlagMapping[] = {
 //	{0x80,"Thumb"},
 //	{0x40,"ARM"},
@@ -153,8 +172,10 @@ struct intToString compareFlagMapping[] = {
 //case 'i':	flag = 0x3;	break;
 struct ConditionalBreak* addConditionalBreak(uint32_t address, uint8_t flag)
 {
+    conditionalIndexDirty = true;
     uint8_t condIndex = address >> 24;
     struct ConditionalBreak* cond = NULL;
+    breakpointsActive = true;
     BreakSet((&map[condIndex])->breakPoints, address & (&map[condIndex])->mask, ((flag & 0xf) | (flag >> 4)));
     if (flag & 0xf0) {
         struct ConditionalBreak* base = conditionals[condIndex];
@@ -242,12 +263,8 @@ void addCondition(struct ConditionalBreak* base, struct ConditionalBreakNode* to
 //destructors
 void freeConditionalBreak(struct ConditionalBreak* toFree)
 {
-    struct ConditionalBreakNode* freeMe;
-    while (toFree->firstCond) {
-        freeMe = toFree->firstCond;
-        toFree->firstCond = toFree->firstCond->next;
-        free(freeMe);
-    }
+    if (toFree->firstCond)
+        freeConditionalNode(toFree->firstCond);
     free(toFree);
 }
 
@@ -259,22 +276,30 @@ void freeConditionalNode(struct ConditionalBreakNode* toDel)
         free(toDel->address);
     if (toDel->value)
         free(toDel->value);
+    if (toDel->address_code)
+        dexp_free(toDel->address_code);
+    if (toDel->value_code)
+        dexp_free(toDel->value_code);
     free(toDel);
 }
 
 void freeAllConditionals()
 {
+    conditionalIndexDirty = true;
     for (int i = 0; i < 16; i++) {
         while (conditionals[i]) {
             struct ConditionalBreak* tmp = conditionals[i];
             conditionals[i] = conditionals[i]->next;
             freeConditionalBreak(tmp);
         }
+        breakRanges[i].clear();
+        breakRangesMaxEnd[i].clear();
     }
 }
 
 int removeConditionalBreak(struct ConditionalBreak* toDelete)
 {
+    conditionalIndexDirty = true;
     if (toDelete) {
         uint8_t condIndex = toDelete->break_address >> 24;
         struct ConditionalBreak* base = conditionals[condIndex];
@@ -418,6 +443,7 @@ void recountFlagsForAddress(uint32_t address)
 //Removers
 int removeConditionalBreakNo(uint32_t addrNo, uint8_t number)
 {
+    conditionalIndexDirty = true;
     if (conditionals[addrNo >> 24]) {
         struct ConditionalBreak* base = conditionals[addrNo >> 24];
         struct ConditionalBreak* curr = conditionals[addrNo >> 24];
@@ -458,6 +484,7 @@ int removeConditionalBreakNo(uint32_t addrNo, uint8_t number)
 
 int removeFlagFromConditionalBreakNo(uint32_t addrNo, uint8_t number, uint8_t flag)
 {
+    conditionalIndexDirty = true;
     if (conditionals[addrNo >> 24]) {
         struct ConditionalBreak* base = conditionals[addrNo >> 24];
         struct ConditionalBreak* curr = conditionals[addrNo >> 24];
@@ -506,6 +533,7 @@ int removeFlagFromConditionalBreakNo(uint32_t addrNo, uint8_t number, uint8_t fl
 
 int removeConditionalWithAddress(uint32_t address)
 {
+    conditionalIndexDirty = true;
     uint8_t addrNo = address >> 24;
     if (conditionals[addrNo] != NULL) {
         struct ConditionalBreak* base = conditionals[addrNo];
@@ -532,6 +560,7 @@ int removeConditionalWithAddress(uint32_t address)
 
 int removeConditionalWithFlag(uint8_t flag, bool orMode)
 {
+    conditionalIndexDirty = true;
     for (uint8_t addrNo = 0; addrNo < 16; addrNo++) {
         if (conditionals[addrNo] != NULL) {
             struct ConditionalBreak* base = conditionals[addrNo];
@@ -569,6 +598,7 @@ int removeConditionalWithFlag(uint8_t flag, bool orMode)
 
 int removeConditionalWithAddressAndFlag(uint32_t address, uint8_t flag, bool orMode)
 {
+    conditionalIndexDirty = true;
     uint8_t addrNo = address >> 24;
     if (conditionals[addrNo] != NULL) {
         struct ConditionalBreak* base = conditionals[addrNo];
@@ -603,6 +633,115 @@ int removeConditionalWithAddressAndFlag(uint32_t address, uint8_t flag, bool orM
     return -2;
 }
 
+//Range watchpoints
+static void rebuildBreakRangesMaxEnd(uint8_t addrNo)
+{
+    std::vector<BreakRange>& ranges = breakRanges[addrNo];
+    std::vector<uint32_t>& maxEnd = breakRangesMaxEnd[addrNo];
+    maxEnd.resize(ranges.size());
+    uint32_t highest = 0;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (ranges[i].end > highest)
+            highest = ranges[i].end;
+        maxEnd[i] = highest;
+    }
+}
+
+static bool breakRangeStartLess(uint32_t address, const BreakRange& range)
+{
+    return address < range.start;
+}
+
+static void setBreakFlags(uint32_t start, uint32_t end, uint8_t flag)
+{
+    uint8_t addrNo = start >> 24;
+    for (uint32_t address = start;; address++) {
+        BreakSet((&map[addrNo])->breakPoints, address & (&map[addrNo])->mask, flag);
+        if (address == end)
+            break;
+    }
+}
+
+void addBreakRange(uint32_t address, uint32_t length, uint8_t flag)
+{
+    flag &= 0xf;
+    if (!length || !flag)
+        return;
+    breakpointsActive = true;
+    uint32_t last = address + (length - 1);
+    if (last < address)
+        last = 0xffffffff;
+    // split the range at region boundaries so each region only holds its own part
+    for (;;) {
+        if ((address >> 24) >= 16)
+            break;
+        uint8_t addrNo = address >> 24;
+        uint32_t end = std::min(last, address | 0x00ffffff);
+        if (map[addrNo].breakPoints) {
+            BreakRange range = { address, end, flag };
+            std::vector<BreakRange>& ranges = breakRanges[addrNo];
+            ranges.insert(std::upper_bound(ranges.begin(), ranges.end(), address, breakRangeStartLess), range);
+            rebuildBreakRangesMaxEnd(addrNo);
+            setBreakFlags(address, end, flag);
+        }
+        if (end == last)
+            break;
+        address = end + 1;
+    }
+}
+
+int removeBreakRange(uint32_t address, uint32_t length, uint8_t flag)
+{
+    flag &= 0xf;
+    if (!length || !flag)
+        return -2;
+    int count = 0;
+    uint32_t last = address + (length - 1);
+    if (last < address)
+        last = 0xffffffff;
+    for (;;) {
+        if ((address >> 24) >= 16)
+            break;
+        uint8_t addrNo = address >> 24;
+        uint32_t end = std::min(last, address | 0x00ffffff);
+        std::vector<BreakRange>& ranges = breakRanges[addrNo];
+        bool found = false;
+        for (size_t i = 0; i < ranges.size();) {
+            if (ranges[i].start == address && ranges[i].end == end && (ranges[i].flags & flag)) {
+                ranges[i].flags &= ~flag;
+                found = true;
+                count++;
+                if (!ranges[i].flags) {
+                    ranges.erase(ranges.begin() + i);
+                    continue;
+                }
+            }
+            i++;
+        }
+        if (found) {
+            rebuildBreakRangesMaxEnd(addrNo);
+            // other breaks may still cover some of these bytes
+            for (uint32_t byte = address;; byte++) {
+                BreakClear((&map[addrNo])->breakPoints, byte & (&map[addrNo])->mask, flag);
+                if (byte == end)
+                    break;
+            }
+            for (size_t i = 0; i < ranges.size() && ranges[i].start <= end; i++) {
+                if (ranges[i].end >= address)
+                    setBreakFlags(std::max(ranges[i].start, address), std::min(ranges[i].end, end), ranges[i].flags);
+            }
+            for (struct ConditionalBreak* base = conditionals[addrNo]; base && base->break_address <= end; base = base->next) {
+                if (base->break_address >= address)
+                    setBreakFlags(base->break_address, base->break_address, (base->type_flags & 0xf) | (base->type_flags >> 4));
+            }
+        }
+        if (end == last)
+            break;
+        address = end + 1;
+    }
+    return count ? count : -2;
+}
+
 //true creating code for a given expression.
 //It assumes an if was found, and that all up to the if was removed.
 //receives an array of chars following the pattern:
@@ -616,7 +755,7 @@ void parseAndCreateConditionalBreaks(uint32_t address, uint8_t flags, char** exp
     flags &= 0xf;
     if (!flags)
         return;
-    struct ConditionalBreakNode* now = (struct ConditionalBreakNode*)malloc(sizeof(struct ConditionalBreakNode));
+    struct ConditionalBreakNode* now = (struct ConditionalBreakNode*)calloc(1, sizeof(struct ConditionalBreakNode));
     struct ConditionalBreakNode* toAdd = now;
     for (int i = 0; i < n; i++) {
         now->next = 0;
@@ -649,22 +788,24 @@ void parseAndCreateConditionalBreaks(uint32_t address, uint8_t flags, char** exp
         }
         now->value = strdup(exp[i]);
         i++;
-        uint32_t val;
-        if (!dexp_eval(now->value, &val) || !dexp_eval(now->address, &val)) {
+        now->value_code = dexp_compile(now->value);
+        now->address_code = dexp_compile(now->address);
+        if (!now->value_code || !now->address_code) {
             printf("Invalid expression.\n");
+            freeConditionalNode(toAdd);
             if (workBreak)
                 removeConditionalBreak(workBreak);
             return;
         }
         if (i < n) {
             if (strcmp(exp[i], "&&") == 0) {
-                now = (struct ConditionalBreakNode*)malloc(sizeof(struct ConditionalBreakNode));
-                toAdd->next = now;
+                now->next = (struct ConditionalBreakNode*)calloc(1, sizeof(struct ConditionalBreakNode));
+                now = now->next;
             } else if (strcmp(exp[i], "||") == 0) {
                 addCondition(workBreak, toAdd);
                 printf("Added break on address %08x, with condition:\n%s %s %s\n", address, now->address, operandName, now->value);
                 workBreak = addConditionalBreak(address, flags);
-                now = (struct ConditionalBreakNode*)malloc(sizeof(struct ConditionalBreakNode));
+                now = (struct ConditionalBreakNode*)calloc(1, sizeof(struct ConditionalBreakNode));
                 toAdd = now;
             }
         } else {
@@ -791,13 +932,9 @@ uint8_t parseConditionOperand(char* type)
     return flag;
 }
 
-uint32_t calculateFinalValue(char* expToEval, uint8_t type_of_flags)
+uint32_t calculateFinalValue(const struct dexp_code* expToEval, uint8_t type_of_flags)
 {
-    uint32_t val;
-    if (!dexp_eval(expToEval, &val)) {
-        printf("Invalid expression.\n");
-        return 0;
-    }
+    uint32_t val = dexp_run(expToEval);
     if (type_of_flags & 0x4) {
         switch (type_of_flags & 0x3) {
         case 0:
@@ -833,8 +970,8 @@ bool doBreak(struct ConditionalBreak* toTest)
     bool globalVeredict = true;
     bool veredict = false;
     while (toExamine && globalVeredict) {
-        uint32_t address = calculateFinalValue(toExamine->address, toExamine->exp_type_flags & 0xf);
-        uint32_t value = calculateFinalValue(toExamine->value, toExamine->exp_type_flags >> 4);
+        uint32_t address = calculateFinalValue(toExamine->address_code, toExamine->exp_type_flags & 0xf);
+        uint32_t value = calculateFinalValue(toExamine->value_code, toExamine->exp_type_flags >> 4);
         if ((toExamine->cond_flags & 0x7) != 0) {
             veredict = veredict || ((toExamine->cond_flags & 1) ? (address == value) : false);
             veredict = veredict || ((toExamine->cond_flags & 4) ? ((toExamine->cond_flags & 8) ? ((int)address < (int)value) : (address < value)) : false);
@@ -846,22 +983,47 @@ bool doBreak(struct ConditionalBreak* toTest)
     return globalVeredict;
 }
 
+static bool conditionalAddressLess(const struct ConditionalBreak* base, uint32_t address)
+{
+    return base->break_address < address;
+}
+
+static void rebuildConditionalIndex()
+{
+    for (int i = 0; i < 16; i++) {
+        conditionalIndex[i].clear();
+        for (struct ConditionalBreak* base = conditionals[i]; base; base = base->next)
+            conditionalIndex[i].push_back(base);
+    }
+    conditionalIndexDirty = false;
+}
+
 bool doesBreak(uint32_t address, uint8_t allowedFlags)
 {
     uint8_t addrNo = address >> 24;
-    if (conditionals[addrNo]) {
-        struct ConditionalBreak* base = conditionals[addrNo];
-        while (base && base->break_address < address) {
-            base = base->next;
+    const std::vector<BreakRange>& ranges = breakRanges[addrNo];
+    if (!ranges.empty()) {
+        const std::vector<uint32_t>& maxEnd = breakRangesMaxEnd[addrNo];
+        size_t i = std::upper_bound(ranges.begin(), ranges.end(), address, breakRangeStartLess) - ranges.begin();
+        while (i > 0 && maxEnd[i - 1] >= address) {
+            i--;
+            if (ranges[i].end >= address && (ranges[i].flags & allowedFlags))
+                return true;
         }
-        while (base && base->break_address == address) {
+    }
+    if (conditionals[addrNo]) {
+        if (conditionalIndexDirty)
+            rebuildConditionalIndex();
+        const std::vector<struct ConditionalBreak*>& index = conditionalIndex[addrNo];
+        std::vector<struct ConditionalBreak*>::const_iterator it = std::lower_bound(index.begin(), index.end(), address, conditionalAddressLess);
+        for (; it != index.end() && (*it)->break_address == address; ++it) {
+            struct ConditionalBreak* base = *it;
             if (base->type_flags & allowedFlags & 0xf0) {
                 return true;
             }
             if (isCorrectBreak(base, allowedFlags) && doBreak(base)) {
                 return true;
             }
-            base = base->next;
         }
     }
     return false;
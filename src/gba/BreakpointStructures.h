@@ -14,6 +14,8 @@
 struct ConditionalBreakNode {
     char* address;
     char* value;
+    struct dexp_code* address_code;
+    struct dexp_code* value_code;
     uint8_t cond_flags;
     uint8_t exp_type_flags;
     struct ConditionalBreakNode* next;
@@ -43,6 +45,10 @@ int removeFlagFromConditionalBreakNo(uint32_t address, uint8_t number, uint8_t f
 int removeConditionalWithAddress(uint32_t address);
 int removeConditionalWithFlag(uint8_t flag, bool orMode);
 int removeConditionalWithAddressAndFlag(uint32_t address, uint8_t flag, bool orMode);
+
+// unconditional read/write watchpoints over length bytes (flag 0x1-0x3)
+void addBreakRange(uint32_t address, uint32_t length, uint8_t flag);
+int removeBreakRange(uint32_t address, uint32_t length, uint8_t flag);
 // void freeConditionalBreak(struct ConditionalBreak* toFree);
 
 void addCondition(struct ConditionalBreak* base, struct ConditionalBreakNode* toAdd);
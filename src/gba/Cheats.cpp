@@ -563,6 +563,286 @@ static int getCodeLength(int num)
     return 1;
 }
 
+// The cheat list is compiled, whenever it changes, into what
+// cheatsCheckKeys() needs each frame: where to go on after a line, past any
+// disabled codes, and the constant writes that are sure to run every time,
+// gathered into runs that are done without going through the interpreter.
+// Sure to run means no code before it could skip over it or turn codes off;
+// of those, ROM writes are made once here instead of every frame.
+struct CheatWrite {
+    uint32_t address;
+    uint32_t value;
+    int size;
+};
+
+struct CheatStep {
+    int first; // run of cheatsWrites starting at this line, -1 if none
+    int last;
+    int resume; // line after the run
+};
+
+static bool cheatsCompiled = false;
+static int cheatsNext[MAX_CHEATS + 1];
+static CheatStep cheatsSteps[MAX_CHEATS];
+static CheatWrite cheatsWrites[MAX_CHEATS];
+
+// the line run after getting to line i
+static inline int cheatsNextLine(int i)
+{
+    return i < cheatsNumber ? cheatsNext[i] : cheatsNumber;
+}
+
+// lines following line i that it skips or uses as data, at most
+static int cheatsLinesTaken(int i)
+{
+    switch (cheatsList[i].size) {
+    case CBA_IF_KEYS_PRESSED:
+    case CBA_IF_TRUE:
+    case CBA_IF_FALSE:
+    case CBA_SLIDE_CODE:
+    case CBA_LT:
+    case CBA_GT:
+    case GSA_8_BIT_IF_TRUE:
+    case GSA_32_BIT_IF_TRUE:
+    case GSA_8_BIT_IF_FALSE:
+    case GSA_32_BIT_IF_FALSE:
+    case GSA_8_BIT_IF_LOWER_U:
+    case GSA_16_BIT_IF_LOWER_U:
+    case GSA_32_BIT_IF_LOWER_U:
+    case GSA_8_BIT_IF_HIGHER_U:
+    case GSA_16_BIT_IF_HIGHER_U:
+    case GSA_32_BIT_IF_HIGHER_U:
+    case GSA_8_BIT_IF_AND:
+    case GSA_16_BIT_IF_AND:
+    case GSA_32_BIT_IF_AND:
+    case GSA_8_BIT_IF_LOWER_S:
+    case GSA_16_BIT_IF_LOWER_S:
+    case GSA_32_BIT_IF_LOWER_S:
+    case GSA_8_BIT_IF_HIGHER_S:
+    case GSA_16_BIT_IF_HIGHER_S:
+    case GSA_32_BIT_IF_HIGHER_S:
+    case GSA_16_BIT_IF_LOWER_OR_EQ_U:
+    case GSA_16_BIT_IF_HIGHER_OR_EQ_U:
+    case GSA_ALWAYS:
+    case GSA_8_BIT_SLIDE:
+    case GSA_16_BIT_SLIDE:
+    case GSA_32_BIT_SLIDE:
+    case GSA_8_BIT_GS_WRITE2:
+    case GSA_16_BIT_GS_WRITE2:
+    case GSA_32_BIT_GS_WRITE2:
+    case GSA_16_BIT_ROM_PATCH2C:
+    case GSA_16_BIT_ROM_PATCH2D:
+    case GSA_16_BIT_ROM_PATCH2E:
+    case GSA_16_BIT_ROM_PATCH2F:
+    case GSA_32_BIT_ADD2:
+    case GSA_32_BIT_SUB2:
+        return 1;
+    case GSA_8_BIT_IF_TRUE2:
+    case GSA_16_BIT_IF_TRUE2:
+    case GSA_32_BIT_IF_TRUE2:
+    case GSA_8_BIT_IF_FALSE2:
+    case GSA_16_BIT_IF_FALSE2:
+    case GSA_32_BIT_IF_FALSE2:
+    case GSA_8_BIT_IF_LOWER_U2:
+    case GSA_16_BIT_IF_LOWER_U2:
+    case GSA_32_BIT_IF_LOWER_U2:
+    case GSA_8_BIT_IF_HIGHER_U2:
+    case GSA_16_BIT_IF_HIGHER_U2:
+    case GSA_32_BIT_IF_HIGHER_U2:
+    case GSA_8_BIT_IF_AND2:
+    case GSA_16_BIT_IF_AND2:
+    case GSA_32_BIT_IF_AND2:
+    case GSA_8_BIT_IF_LOWER_S2:
+    case GSA_16_BIT_IF_LOWER_S2:
+    case GSA_32_BIT_IF_LOWER_S2:
+    case GSA_8_BIT_IF_HIGHER_S2:
+    case GSA_16_BIT_IF_HIGHER_S2:
+    case GSA_32_BIT_IF_HIGHER_S2:
+    case GSA_ALWAYS2:
+        return 2;
+    case GSA_16_BIT_MIF_TRUE:
+    case GSA_16_BIT_MIF_FALSE:
+    case GSA_16_BIT_MIF_LOWER_OR_EQ_U:
+    case GSA_16_BIT_MIF_HIGHER_OR_EQ_U:
+        return (cheatsList[i].rawaddress >> 0x10) & 0xFF;
+    case CBA_SUPER:
+        return (2 * ((cheatsList[i].value - 1) & 0xFFFF) + 1) / 6 + 1;
+    case GSA_GROUP_WRITE:
+        return (cheatsList[i].address & 0xFFFE) / 2;
+    }
+    return 0;
+}
+
+// true for the codes that stop the following ones until GSA_CODES_ON
+static bool cheatsTurnsOff(int i)
+{
+    switch (cheatsList[i].size) {
+    case GSA_8_BIT_IF_TRUE3:
+    case GSA_16_BIT_IF_TRUE3:
+    case GSA_32_BIT_IF_TRUE3:
+    case GSA_8_BIT_IF_FALSE3:
+    case GSA_16_BIT_IF_FALSE3:
+    case GSA_32_BIT_IF_FALSE3:
+    case GSA_8_BIT_IF_LOWER_S3:
+    case GSA_16_BIT_IF_LOWER_S3:
+    case GSA_32_BIT_IF_LOWER_S3:
+    case GSA_8_BIT_IF_HIGHER_S3:
+    case GSA_16_BIT_IF_HIGHER_S3:
+    case GSA_32_BIT_IF_HIGHER_S3:
+    case GSA_8_BIT_IF_LOWER_U3:
+    case GSA_16_BIT_IF_LOWER_U3:
+    case GSA_32_BIT_IF_LOWER_U3:
+    case GSA_8_BIT_IF_HIGHER_U3:
+    case GSA_16_BIT_IF_HIGHER_U3:
+    case GSA_32_BIT_IF_HIGHER_U3:
+    case GSA_8_BIT_IF_AND3:
+    case GSA_16_BIT_IF_AND3:
+    case GSA_32_BIT_IF_AND3:
+    case GSA_ALWAYS3:
+        return true;
+    }
+    return false;
+}
+
+static void cheatsCompile()
+{
+    int i;
+
+    cheatsNext[cheatsNumber] = cheatsNumber;
+    for (i = cheatsNumber - 1; i >= 0; i--) {
+        if (cheatsList[i].enabled)
+            cheatsNext[i] = i;
+        else
+            cheatsNext[i] = cheatsNextLine(i + getCodeLength(i));
+    }
+
+    // a ROM write can only be patched in once if nothing else writes ROM;
+    // otherwise the order of the writes each frame decides what stays
+    int romWriters = 0;
+    for (i = 0; i < cheatsNumber; i++) {
+        if (!cheatsList[i].enabled)
+            continue;
+        switch (cheatsList[i].size) {
+        case GSA_16_BIT_ROM_PATCH:
+        case GSA_16_BIT_ROM_PATCH2C:
+        case GSA_16_BIT_ROM_PATCH2D:
+        case GSA_16_BIT_ROM_PATCH2E:
+        case GSA_16_BIT_ROM_PATCH2F:
+            romWriters++;
+            break;
+        case CHEATS_16_BIT_WRITE:
+        case CHEATS_32_BIT_WRITE:
+            if ((cheatsList[i].address >> 24) >= 0x08)
+                romWriters++;
+            break;
+        }
+    }
+
+    int skipped = 0; // lines before this one may be skipped
+    int taken = 0; // ... or are data for an earlier code
+    int hidden = 0; // ... or belong to a disabled code
+    bool on = true;
+    int count = 0;
+
+    for (i = 0; i < cheatsNumber; i++) {
+        CheatsData& c = cheatsList[i];
+        bool sure = c.enabled && i >= skipped && i >= taken && i >= hidden;
+        cheatsSteps[i].first = -1;
+
+        // cheatsCheckKeys() steps over the other lines of a disabled code
+        if (!c.enabled && i + getCodeLength(i) > hidden)
+            hidden = i + getCodeLength(i);
+
+        // lines used as data still go through the second switch
+        if (c.enabled || i < taken) {
+            int n = cheatsLinesTaken(i);
+            if (i + n + 1 > skipped)
+                skipped = i + n + 1;
+            if (cheatsTurnsOff(i))
+                on = false;
+
+            switch (c.size) {
+            case CBA_SLIDE_CODE:
+            case CBA_SUPER:
+            case GSA_GROUP_WRITE:
+            case GSA_32_BIT_ADD2:
+            case GSA_32_BIT_SUB2:
+            case GSA_8_BIT_SLIDE:
+            case GSA_16_BIT_SLIDE:
+            case GSA_32_BIT_SLIDE:
+            case GSA_8_BIT_GS_WRITE2:
+            case GSA_16_BIT_GS_WRITE2:
+            case GSA_32_BIT_GS_WRITE2:
+            case GSA_16_BIT_ROM_PATCH2C:
+            case GSA_16_BIT_ROM_PATCH2D:
+            case GSA_16_BIT_ROM_PATCH2E:
+            case GSA_16_BIT_ROM_PATCH2F:
+                if (i + cheatsLinesTaken(i) + 1 > taken)
+                    taken = i + cheatsLinesTaken(i) + 1;
+                break;
+            }
+        }
+        if (sure && c.size == GSA_CODES_ON)
+            on = true;
+
+        if (!sure || !on)
+            continue;
+
+        int size;
+        switch (c.size) {
+        case INT_8_BIT_WRITE:
+            size = 1;
+            break;
+        case INT_16_BIT_WRITE:
+        case CHEATS_16_BIT_WRITE:
+            size = 2;
+            break;
+        case INT_32_BIT_WRITE:
+        case CHEATS_32_BIT_WRITE:
+            size = 4;
+            break;
+        default:
+            continue;
+        }
+
+        cheatsSteps[i].first = count;
+        if ((c.size == CHEATS_16_BIT_WRITE || c.size == CHEATS_32_BIT_WRITE)
+            && (c.address >> 24) >= 0x08 && romWriters == 1) {
+            if (size == 2) {
+                CHEAT_PATCH_ROM_16BIT(c.address, c.value);
+            } else {
+                CHEAT_PATCH_ROM_32BIT(c.address, c.value);
+            }
+            continue;
+        }
+        cheatsWrites[count].address = c.address;
+        cheatsWrites[count].value = c.value;
+        // negative for the ROM writes kept per frame
+        if ((c.size == CHEATS_16_BIT_WRITE || c.size == CHEATS_32_BIT_WRITE) && (c.address >> 24) >= 0x08)
+            size = -size;
+        cheatsWrites[count].size = size;
+        count++;
+    }
+
+    // join each write to those right after it
+    for (i = cheatsNumber - 1; i >= 0; i--) {
+        CheatStep& step = cheatsSteps[i];
+        if (step.first < 0)
+            continue;
+        int next = cheatsNextLine(i + 1);
+        if (next < cheatsNumber && cheatsSteps[next].first >= 0) {
+            step.last = cheatsSteps[next].last;
+            step.resume = cheatsSteps[next].resume;
+        } else {
+            step.last = count;
+            step.resume = next;
+        }
+        count = step.first;
+    }
+
+    cheatsCompiled = true;
+}
+
 int cheatsCheckKeys(uint32_t keys, uint32_t extended)
 {
     bool onoff = true;
@@ -576,12 +856,36 @@ int cheatsCheckKeys(uint32_t keys, uint32_t extended)
             rompatch2addr[i] = 0;
         }
 
-    for (i = 0; i < cheatsNumber; i++) {
-        if (!cheatsList[i].enabled) {
-            // make sure we skip other lines in this code
-            i += getCodeLength(i) - 1;
+    if (!cheatsCompiled)
+        cheatsCompile();
+
+    for (i = cheatsNextLine(0); i < cheatsNumber; i = cheatsNextLine(i + 1)) {
+        const CheatStep& step = cheatsSteps[i];
+        if (step.first >= 0) {
+            for (int w = step.first; w < step.last; w++) {
+                const CheatWrite& cw = cheatsWrites[w];
+                switch (cw.size) {
+                case 1:
+                    CPUWriteByte(cw.address, cw.value);
+                    break;
+                case 2:
+                    CPUWriteHalfWord(cw.address, cw.value);
+                    break;
+                case 4:
+                    CPUWriteMemory(cw.address, cw.value);
+                    break;
+                case -2:
+                    CHEAT_PATCH_ROM_16BIT(cw.address, cw.value);
+                    break;
+                case -4:
+                    CHEAT_PATCH_ROM_32BIT(cw.address, cw.value);
+                    break;
+                }
+            }
+            i = step.resume - 1;
             continue;
         }
+
         switch (cheatsList[i].size) {
         case GSA_CODES_ON:
             onoff = true;
@@ -1320,6 +1624,7 @@ void cheatsAdd(const char* codeStr,
             break;
         }
         cheatsNumber++;
+        cheatsCompiled = false;
     }
 }
 
@@ -1376,6 +1681,7 @@ void cheatsDelete(int number, bool restore)
             memcpy(&cheatsList[x], &cheatsList[x + 1], sizeof(CheatsData) * (cheatsNumber - x - 1));
         }
         cheatsNumber--;
+        cheatsCompiled = false;
     }
 }
 
@@ -1390,6 +1696,7 @@ void cheatsEnable(int i)
 {
     if (i >= 0 && i < cheatsNumber) {
         cheatsList[i].enabled = true;
+        cheatsCompiled = false;
         mastercode = 0;
     }
 }
@@ -1418,6 +1725,7 @@ void cheatsDisable(int i)
             break;
         }
         cheatsList[i].enabled = false;
+        cheatsCompiled = false;
     }
 }
 
@@ -2590,6 +2898,7 @@ void cheatsReadGame(gzFile file, int version)
 
     if (cheatsNumber > MAX_CHEATS)
         cheatsNumber = MAX_CHEATS;
+    cheatsCompiled = false;
 
     if (version > 8)
         utilGzRead(file, cheatsList, sizeof(cheatsList));
@@ -2792,6 +3101,7 @@ bool cheatsLoadCheatList(const char* file)
         }
     }
     cheatsNumber = count;
+    cheatsCompiled = false;
     fclose(f);
     return true;
 }
@@ -2827,10 +2827,11 @@ static void tester(void) {
 }
 #endif
 
-int armExecute()
+template <bool checkCheats, bool checkDebugger>
+static int armExecuteLoop()
 {
     do {
-        if (cheatsEnabled) {
+        if (checkCheats) {
             cpuMasterCodeCheck();
         }
 
@@ -2848,7 +2849,7 @@ int armExecute()
         int oldArmNextPC = armNextPC;
 
 #ifndef FINAL_VERSION
-        if (armNextPC == stop) {
+        if (checkDebugger && armNextPC == stop) {
             armNextPC++;
         }
 #endif
@@ -2858,13 +2859,15 @@ int armExecute()
         ARM_PREFETCH_NEXT;
 
 #ifdef BKPT_SUPPORT
-        uint32_t memAddr = armNextPC;
-        memoryMap* m = &map[memAddr >> 24];
-        if (m->breakPoints && BreakARMCheck(m->breakPoints, memAddr & m->mask)) {
-            if (debuggerBreakOnExecution(memAddr, armState)) {
-                // Revert tickcount?
-                debugger = true;
-                return 0;
+        if (checkDebugger) {
+            uint32_t memAddr = armNextPC;
+            memoryMap* m = &map[memAddr >> 24];
+            if (m->breakPoints && BreakARMCheck(m->breakPoints, memAddr & m->mask)) {
+                if (debuggerBreakOnExecution(memAddr, armState)) {
+                    // Revert tickcount?
+                    debugger = true;
+                    return 0;
+                }
             }
         }
 #endif
@@ -2933,7 +2936,7 @@ int armExecute()
 #endif
 
 #ifdef BKPT_SUPPORT
-        if (enableRegBreak) {
+        if (checkDebugger && enableRegBreak) {
             if (lowRegBreakCounter[0])
                 breakReg_check(0);
             if (lowRegBreakCounter[1])
@@ -2978,3 +2981,24 @@ int armExecute()
 
     return 1;
 }
+
+// The cheat master code and debugger checks are only compiled into the
+// loop variants that need them, picked once per call.
+int armExecute()
+{
+#ifdef BKPT_SUPPORT
+    bool checkDebugger = breakpointsActive || enableRegBreak;
+#else
+    bool checkDebugger = false;
+#endif
+
+    if (cheatsEnabled && mastercode) {
+        if (checkDebugger)
+            return armExecuteLoop<true, true>();
+        return armExecuteLoop<true, false>();
+    }
+
+    if (checkDebugger)
+        return armExecuteLoop<false, true>();
+    return armExecuteLoop<false, false>();
+}
@@ -1997,10 +1997,11 @@ static insnfunc_t thumbInsnTable[1024] = {
 
 // Wrapper routine (execution loop) ///////////////////////////////////////
 
-int thumbExecute()
+template <bool checkCheats, bool checkDebugger>
+static int thumbExecuteLoop()
 {
     do {
-        if (cheatsEnabled) {
+        if (checkCheats) {
             cpuMasterCodeCheck();
         }
 
@@ -2017,7 +2018,7 @@ int thumbExecute()
         uint32_t oldArmNextPC = armNextPC;
 
 #ifndef FINAL_VERSION
-        if (armNextPC == stop) {
+        if (checkDebugger && armNextPC == stop) {
             armNextPC++;
         }
 #endif
@@ -2027,13 +2028,15 @@ int thumbExecute()
         THUMB_PREFETCH_NEXT;
 
 #ifdef BKPT_SUPPORT
-        uint32_t memAddr = armNextPC;
-        memoryMap* m = &map[memAddr >> 24];
-        if (m->breakPoints && BreakThumbCheck(m->breakPoints, memAddr & m->mask)) {
-            if (debuggerBreakOnExecution(memAddr, armState)) {
-                // Revert tickcount?
-                debugger = true;
-                return 0;
+        if (checkDebugger) {
+            uint32_t memAddr = armNextPC;
+            memoryMap* m = &map[memAddr >> 24];
+            if (m->breakPoints && BreakThumbCheck(m->breakPoints, memAddr & m->mask)) {
+                if (debuggerBreakOnExecution(memAddr, armState)) {
+                    // Revert tickcount?
+                    debugger = true;
+                    return 0;
+                }
             }
         }
 #endif
@@ -2041,7 +2044,7 @@ int thumbExecute()
         (*thumbInsnTable[opcode >> 6])(opcode);
 
 #ifdef BKPT_SUPPORT
-        if (enableRegBreak) {
+        if (checkDebugger && enableRegBreak) {
             if (lowRegBreakCounter[0])
                 breakReg_check(0);
             if (lowRegBreakCounter[1])
@@ -2086,3 +2089,24 @@ int thumbExecute()
     } while (cpuTotalTicks < cpuNextEvent && !armState && !holdState && !SWITicks && !debugger);
     return 1;
 }
+
+// The cheat master code and debugger checks are only compiled into the
+// loop variants that need them, picked once per call.
+int thumbExecute()
+{
+#ifdef BKPT_SUPPORT
+    bool checkDebugger = breakpointsActive || enableRegBreak;
+#else
+    bool checkDebugger = false;
+#endif
+
+    if (cheatsEnabled && mastercode) {
+        if (checkDebugger)
+            return thumbExecuteLoop<true, true>();
+        return thumbExecuteLoop<true, false>();
+    }
+
+    if (checkDebugger)
+        return thumbExecuteLoop<false, true>();
+    return thumbExecuteLoop<false, false>();
+}
@@ -1008,6 +1008,30 @@ bool CPUWriteBatteryFile(const char* fileName)
     return true;
 }
 
+// the memory CPUWriteBatteryFile() dumps, if it dumps anything
+uint8_t* CPUBatteryData(int& size)
+{
+    if (!saveType || saveType == GBA_SAVE_NONE)
+        return NULL;
+
+    if (eepromInUse) {
+        size = eepromSize;
+        return eepromData;
+    }
+
+    if (saveType == GBA_SAVE_FLASH) {
+        size = flashSize;
+        return flashSaveMemory;
+    }
+
+    if (saveType == GBA_SAVE_SRAM) {
+        size = 0x8000;
+        return flashSaveMemory;
+    }
+
+    return NULL;
+}
+
 bool CPUReadGSASnapshot(const char* fileName)
 {
     int i;
@@ -1363,6 +1387,82 @@ bool CPUIsELF(const char* file)
     return false;
 }
 
+// declared in Util.h; lives here because the libretro core has its own Util
+int utilGBAFindSaveType(const uint8_t* data, int size, int& flashSize, bool& rtcFound)
+{
+    const uint32_t* p = (const uint32_t*)data;
+    const uint32_t* end = (const uint32_t*)(data + size);
+    int detectedSaveType = 0;
+    flashSize = 0x10000;
+    rtcFound = false;
+
+    while (p < end) {
+        const uint32_t* stop = end - p > 16 ? p + 16 : end;
+
+        // every marker starts with four capital letters, so skip blocks of
+        // sixteen words without such a word, testing two words at a time
+        if (stop - p == 16) {
+            uint64_t hit = 0;
+            for (int i = 0; i < 16; i += 2) {
+                uint64_t x, y, caps;
+                memcpy(&x, p + i, 8);
+                y = x & 0x7F7F7F7F7F7F7F7FULL;
+                caps = (y + 0x3F3F3F3F3F3F3F3FULL) & ~(y + 0x2525252525252525ULL) & ~x & 0x8080808080808080ULL;
+                caps &= caps >> 16;
+                hit |= caps & (caps >> 8);
+            }
+            if (!(hit & 0x0000008000000080ULL)) {
+                p = stop;
+                continue;
+            }
+        }
+
+        while (p < stop) {
+            uint32_t d = READ32LE(p);
+
+            if (d == 0x52504545) {
+                if (memcmp(p, "EEPROM_", 7) == 0) {
+                    if (detectedSaveType == 0 || detectedSaveType == 4)
+                        detectedSaveType = 1;
+                }
+            } else if (d == 0x4D415253) {
+                if (memcmp(p, "SRAM_", 5) == 0) {
+                    if (detectedSaveType == 0 || detectedSaveType == 1
+                        || detectedSaveType == 4)
+                        detectedSaveType = 2;
+                }
+            } else if (d == 0x53414C46) {
+                if (memcmp(p, "FLASH1M_", 8) == 0) {
+                    if (detectedSaveType == 0) {
+                        detectedSaveType = 3;
+                        flashSize = 0x20000;
+                    }
+                } else if (memcmp(p, "FLASH512_", 9) == 0) {
+                    if (detectedSaveType == 0) {
+                        detectedSaveType = 3;
+                        flashSize = 0x10000;
+                    }
+                } else if (memcmp(p, "FLASH", 5) == 0) {
+                    if (detectedSaveType == 0) {
+                        detectedSaveType = 4;
+                        flashSize = 0x10000;
+                    }
+                }
+            } else if (d == 0x52494953) {
+                if (memcmp(p, "SIIRTC_V", 8) == 0)
+                    rtcFound = true;
+            }
+            p++;
+        }
+    }
+    // if no matches found, then set it to NONE
+    if (detectedSaveType == 0)
+        detectedSaveType = 5;
+    if (detectedSaveType == 4)
+        detectedSaveType = 3;
+    return detectedSaveType;
+}
+
 void CPUCleanUp()
 {
 #ifdef PROFILING
@@ -1458,6 +1558,7 @@ void SetMapMasks()
 
         }
     }
+    breakpointsActive = false;
     clearBreakRegList();
 #endif
 }
@@ -2331,6 +2432,148 @@ void CPUCompareVCOUNT()
     }
 }
 
+#ifdef BKPT_SUPPORT
+// Returns true when a watchpoint or a frozen cheat covers any byte of
+// [lo, hi], in which case the transfer has to go through the bus handlers.
+static bool dmaWatched(uint32_t lo, uint32_t hi, bool write)
+{
+    memoryMap* m = &map[lo >> 24];
+    uint8_t* freeze = NULL;
+
+    if ((hi - lo) > m->mask || (lo & m->mask) > (hi & m->mask))
+        return true;
+
+    if (m->breakPoints) {
+        uint8_t flag = write ? 0x11 : 0x22;
+        for (uint32_t i = (lo & m->mask) >> 1; i <= ((hi & m->mask) >> 1); i++) {
+            if (m->breakPoints[i] & flag)
+                return true;
+        }
+    }
+
+    if (!write)
+        return false;
+
+    switch (lo >> 24) {
+    case 2:
+        freeze = freezeWorkRAM;
+        break;
+    case 3:
+        freeze = freezeInternalRAM;
+        break;
+    case 5:
+        freeze = freezePRAM;
+        break;
+    case 6:
+        freeze = freezeVRAM;
+        break;
+    case 7:
+        freeze = freezeOAM;
+        break;
+    }
+
+    for (uint32_t i = lo & m->mask; freeze && i <= (hi & m->mask); i++) {
+        if (freeze[i])
+            return true;
+    }
+    return false;
+}
+#endif
+
+// Returns the backing store of a DMA endpoint when every unit of the transfer
+// lands in plain memory, or NULL when it has to go through the bus handlers
+// (BIOS, I/O, ROM GPIO, save chips, VRAM mirrors, watched or frozen ranges,
+// or a region crossing).
+uint8_t* dmaPlainMemory(uint32_t address, uint32_t inc, uint32_t count, uint32_t unit, bool write, uint32_t& mask)
+{
+    uint32_t last = address + inc * (count - 1);
+    uint32_t lo = ((int32_t)inc < 0) ? last : address;
+    uint32_t hi = ((int32_t)inc < 0) ? address : last;
+    uint8_t* memory = NULL;
+
+    if ((address >> 24) != (last >> 24))
+        return NULL;
+
+    switch (address >> 24) {
+    case 2:
+        mask = 0x3FFFF;
+        memory = workRAM;
+        break;
+    case 3:
+        mask = 0x7FFF;
+        memory = internalRAM;
+        break;
+    case 5:
+        mask = 0x3FF;
+        memory = paletteRAM;
+        break;
+    case 6:
+        // stay below the OBJ mirror and the bitmap mode hole
+        if ((lo & ~0x1FFFF) != (hi & ~0x1FFFF) || (hi & 0x1FFFF) + 4 > 0x18000)
+            return NULL;
+        mask = 0x1FFFF;
+        memory = vram;
+        break;
+    case 7:
+        mask = 0x3FF;
+        memory = oam;
+        break;
+    case 8:
+        // the RTC registers live at 0x80000c4-0x80000c9
+        if (write || (lo & 0x1FFFFFF) < 0x100)
+            return NULL;
+        mask = 0x1FFFFFF;
+        memory = rom;
+        break;
+    case 9:
+    case 10:
+    case 11:
+    case 12:
+        if (write)
+            return NULL;
+        mask = 0x1FFFFFF;
+        memory = rom;
+        break;
+    }
+
+#ifdef BKPT_SUPPORT
+    if (memory && dmaWatched(lo, hi + unit - 1, write))
+        return NULL;
+#endif
+    return memory;
+}
+
+// Copies c units between two plain memory regions with the same wraparound
+// and overlap behaviour as the element-by-element bus path.
+void dmaCopyPlain(uint8_t* dst, uint32_t d, uint32_t dMask, uint32_t di,
+    const uint8_t* src, uint32_t s, uint32_t sMask, uint32_t si,
+    uint32_t c, uint32_t unit)
+{
+    uint32_t bytes = c * unit;
+    sMask &= ~(unit - 1);
+    dMask &= ~(unit - 1);
+
+    if (si == unit && di == unit
+        && (s & sMask) + bytes <= sMask + unit
+        && (d & dMask) + bytes <= dMask + unit) {
+        uint8_t* to = &dst[d & dMask];
+        const uint8_t* from = &src[s & sMask];
+
+        // a forward copy onto a later, overlapping range replicates data
+        if (to <= from || to >= from + bytes) {
+            memmove(to, from, bytes);
+            return;
+        }
+    }
+
+    while (c != 0) {
+        memcpy(&dst[d & dMask], &src[s & sMask], unit);
+        d += di;
+        s += si;
+        c--;
+    }
+}
+
 void doDMA(uint32_t& s, uint32_t& d, uint32_t si, uint32_t di, uint32_t c, int transfer32)
 {
     int sm = s >> 24;
@@ -2338,6 +2581,10 @@ void doDMA(uint32_t& s, uint32_t& d, uint32_t si, uint32_t di, uint32_t c, int t
     int sw = 0;
     int dw = 0;
     int sc = c;
+    uint32_t sMask = 0;
+    uint32_t dMask = 0;
+    uint8_t* src = NULL;
+    uint8_t* dst = NULL;
 
     cpuDmaHack = true;
     cpuDmaCount = c;
@@ -2352,12 +2599,24 @@ void doDMA(uint32_t& s, uint32_t& d, uint32_t si, uint32_t di, uint32_t c, int t
 
     if (transfer32) {
         s &= 0xFFFFFFFC;
+        if (!(s < 0x02000000 && (reg[15].I >> 24))) {
+            src = dmaPlainMemory(s, si, c, 4, false, sMask);
+            if (src)
+                dst = dmaPlainMemory(d & 0xFFFFFFFC, di, c, 4, true, dMask);
+        }
         if (s < 0x02000000 && (reg[15].I >> 24)) {
             while (c != 0) {
                 CPUWriteMemory(d, 0);
                 d += di;
                 c--;
             }
+        } else if (dst) {
+            uint32_t last = s + si * (c - 1);
+            dmaCopyPlain(dst, d, dMask, di, src, s, sMask, si, c, 4);
+            cpuDmaLast = READ32LE(((uint32_t*)&src[last & sMask & ~3]));
+            d += di * c;
+            s += si * c;
+            c = 0;
         } else {
             while (c != 0) {
                 cpuDmaLast = CPUReadMemory(s);
@@ -2371,12 +2630,25 @@ void doDMA(uint32_t& s, uint32_t& d, uint32_t si, uint32_t di, uint32_t c, int t
         s &= 0xFFFFFFFE;
         si = (int)si >> 1;
         di = (int)di >> 1;
+        if (!(s < 0x02000000 && (reg[15].I >> 24))) {
+            src = dmaPlainMemory(s, si, c, 2, false, sMask);
+            if (src)
+                dst = dmaPlainMemory(d & 0xFFFFFFFE, di, c, 2, true, dMask);
+        }
         if (s < 0x02000000 && (reg[15].I >> 24)) {
             while (c != 0) {
                 CPUWriteHalfWord(d, 0);
                 d += di;
                 c--;
             }
+        } else if (dst) {
+            uint32_t last = s + si * (c - 1);
+            dmaCopyPlain(dst, d, dMask, di, src, s, sMask, si, c, 2);
+            cpuDmaLast = READ16LE(((uint16_t*)&src[last & sMask & ~1]));
+            cpuDmaLast |= (cpuDmaLast << 16);
+            d += di * c;
+            s += si * c;
+            c = 0;
         } else {
             while (c != 0) {
                 cpuDmaLast = CPUReadHalfWord(s);
@@ -3893,6 +4165,9 @@ void CPULoop(int ticks)
                     } else {
                         if (frameCount >= framesToSkip) {
                             (*renderLine)();
+#ifdef __LIBRETRO__
+                            systemLineDrawn(VCOUNT, lineMix, sizeof(lineMix));
+#endif
                             switch (systemColorDepth) {
                             case 16: {
 #ifdef __LIBRETRO__
@@ -126,6 +126,7 @@ extern bool CPUReadGSASPSnapshot(const char*);
 extern bool CPUWriteGSASnapshot(const char*, const char*, const char*, const char*);
 extern bool CPUWriteBatteryFile(const char*);
 extern bool CPUReadBatteryFile(const char*);
+extern uint8_t* CPUBatteryData(int& size);
 extern bool CPUExportEepromFile(const char*);
 extern bool CPUImportEepromFile(const char*);
 extern bool CPUWritePNGFile(const char*);
@@ -152,6 +153,11 @@ void SetSaveType(int st);
 extern void CPUReset();
 extern void CPULoop(int);
 extern void CPUCheckDMA(int, int);
+// plain-memory shortcuts shared by DMA and the HLE BIOS copies
+extern uint8_t* dmaPlainMemory(uint32_t address, uint32_t inc, uint32_t count, uint32_t unit, bool write, uint32_t& mask);
+extern void dmaCopyPlain(uint8_t* dst, uint32_t d, uint32_t dMask, uint32_t di,
+    const uint8_t* src, uint32_t s, uint32_t sMask, uint32_t si,
+    uint32_t c, uint32_t unit);
 extern bool CPUIsGBAImage(const char*);
 extern bool CPUIsZipFile(const char*);
 #ifdef PROFILING
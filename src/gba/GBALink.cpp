@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <cstring>
 #include <string>
+#include <vector>
 
 // malloc.h does not seem to exist on Mac OS 10.7 and is an error on FreeBSD
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__)
@@ -70,6 +71,7 @@ std::string IP_LINK_BIND_ADDRESS = "*";
 #include "../common/Port.h"
 #include "GBA.h"
 #include "GBALink.h"
+#include "GBALinkRecords.h"
 #include "GBASockClient.h"
 
 #include <SFML/Network.hpp>
@@ -84,6 +86,64 @@ std::string IP_LINK_BIND_ADDRESS = "*";
 
 #if (defined __WIN32__ || defined _WIN32)
 #include <windows.h>
+#define LINK_IPC
+#elif defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#define LINK_IPC
+
+// The link semaphores are plain counters in the shared link memory;
+// waiting on one is a futex wait, so instances waiting for each other
+// sleep until they are signalled instead of polling.
+#define WAIT_TIMEOUT -1
+
+static void ReleaseSemaphore(int32_t* sem, int nrel, void*)
+{
+    if (nrel <= 0)
+        return;
+    __atomic_add_fetch(sem, nrel, __ATOMIC_RELEASE);
+    syscall(SYS_futex, sem, FUTEX_WAKE, nrel, NULL, NULL, 0);
+}
+
+static int WaitForSingleObject(int32_t* sem, int t)
+{
+    struct timespec end, now, left;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += t / 1000;
+    end.tv_nsec += (t % 1000) * 1000000;
+    if (end.tv_nsec >= 1000000000) {
+        end.tv_sec++;
+        end.tv_nsec -= 1000000000;
+    }
+    for (;;) {
+        int32_t count = __atomic_load_n(sem, __ATOMIC_ACQUIRE);
+        while (count > 0)
+            if (__atomic_compare_exchange_n(sem, &count, count - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+                return 0;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left.tv_sec = end.tv_sec - now.tv_sec;
+        left.tv_nsec = end.tv_nsec - now.tv_nsec;
+        if (left.tv_nsec < 0) {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000;
+        }
+        if (left.tv_sec < 0)
+            return WAIT_TIMEOUT;
+        // returns at once if the count is no longer 0
+        syscall(SYS_futex, sem, FUTEX_WAIT, 0, &left, NULL, 0);
+    }
+}
+
+// drop signals left over from an aborted transfer
+static void ResetSemaphore(int32_t* sem)
+{
+    __atomic_store_n(sem, 0, __ATOMIC_RELEASE);
+}
 #else
 #include <errno.h>
 #include <fcntl.h>
@@ -205,6 +265,7 @@ static ConnectionState InitSocket();
 static void StartCableSocket(uint16_t siocnt);
 static ConnectionState ConnectUpdateSocket(char* const message, size_t size);
 static void UpdateCableSocket(int ticks);
+static bool PollCableSocket();
 static void CloseSocket();
 
 const uint64_t TICKS_PER_FRAME = TICKS_PER_SECOND / 60;
@@ -238,6 +299,9 @@ typedef struct {
     uint8_t numgbas; //# of GBAs (max vbaid value plus 1), used in Single computer
     uint8_t trgbas;
     uint8_t linkflags;
+#if !(defined __WIN32__ || defined _WIN32)
+    int32_t linksem[4]; // the futex semaphores of linksync[]
+#endif
 
     uint8_t rfu_proto[5]; // 0=UDP-like, 1=TCP-like protocols to see whether the data important or not (may or may not be received successfully by the other side)
     uint16_t rfu_qid[5];
@@ -334,14 +398,16 @@ bool EmuReseted = true;
 bool LinkIsWaiting = false;
 bool LinkFirstTime = true;
 
-#if (defined __WIN32__ || defined _WIN32)
+#ifdef LINK_IPC
 
 static ConnectionState InitIPC();
 static void StartCableIPC(uint16_t siocnt);
 static void ReconnectCableIPC();
 static void UpdateCableIPC(int ticks);
+#if (defined __WIN32__ || defined _WIN32)
 static void StartRFU(uint16_t siocnt);
 static void UpdateRFUIPC(int ticks);
+#endif
 static void CloseIPC();
 
 #endif
@@ -371,8 +437,10 @@ static GBASockClient* dol = NULL;
 static sf::IpAddress joybusHostAddr = sf::IpAddress::LocalHost;
 
 static const LinkDriver linkDrivers[] = {
-#if (defined __WIN32__ || defined _WIN32)
+#ifdef LINK_IPC
     { LINK_CABLE_IPC, InitIPC, NULL, StartCableIPC, UpdateCableIPC, CloseIPC, false },
+#endif
+#if (defined __WIN32__ || defined _WIN32)
     { LINK_RFU_IPC, InitIPC, NULL, StartRFU, UpdateRFUIPC, CloseIPC, false },
     { LINK_GAMEBOY_IPC, InitIPC, NULL, NULL, NULL, CloseIPC, false },
 #endif
@@ -415,8 +483,6 @@ public:
     sf::TcpSocket tcpsocket[4];
     sf::IpAddress udpaddr[4];
     CableServer(void);
-    void Send(void);
-    void Recv(void);
     void SendGB(void);
     bool RecvGB(void);
 };
@@ -435,11 +501,8 @@ public:
     unsigned short serverport;
     bool transferring;
     CableClient(void);
-    void Send(void);
-    void Recv(void);
     void SendGB(void);
     bool RecvGB(void);
-    void CheckConn(void);
 };
 
 static int i, j;
@@ -475,13 +538,16 @@ static const int trtimeend[3][4] = {
 // Hodgepodge
 static uint8_t tspeed = 3;
 static bool transfer_direction = false;
+// IPC cable: machine whose value is being transferred, plus one (0 = idle)
+static int ipc_transfer = 0;
 static int linkid = 0;
 #if (defined __WIN32__ || defined _WIN32)
 static HANDLE linksync[4];
+#elif defined(__linux__)
+static int32_t* linksync[4];
 #else
 static sem_t* linksync[4];
 #endif
-static int transfer_start_time_from_master = 0;
 #if (defined __WIN32__ || defined _WIN32)
 static HANDLE mmf = NULL;
 #else
@@ -732,11 +798,8 @@ void LinkUpdate(int ticks)
 
 void CheckLinkConnection()
 {
-    if (GetLinkMode() == LINK_CABLE_SOCKET) {
-        if (linkid && !lc.transferring) {
-            lc.CheckConn();
-        }
-    }
+    if (GetLinkMode() == LINK_CABLE_SOCKET)
+        PollCableSocket();
 }
 
 void CloseLink(void)
@@ -760,85 +823,6 @@ CableServer::CableServer(void)
     uint16_toutbuffer = (uint16_t*)outbuffer;
 }
 
-void CableServer::Send(void)
-{
-    if (lanlink.type == 0) { // TCP
-        outbuffer[1] = tspeed;
-        WRITE16LE(&uint16_toutbuffer[1], cable_data[0]);
-        WRITE32LE(&intoutbuffer[1], transfer_start_time_from_master);
-
-        if (lanlink.numslaves == 1) {
-            if (lanlink.type == 0) {
-                outbuffer[0] = 8;
-                tcpsocket[1].send(outbuffer, 8);
-            }
-        } else if (lanlink.numslaves == 2) {
-            WRITE16LE(&uint16_toutbuffer[4], cable_data[2]);
-            if (lanlink.type == 0) {
-                outbuffer[0] = 10;
-                tcpsocket[1].send(outbuffer, 10);
-                WRITE16LE(&uint16_toutbuffer[4], cable_data[1]);
-                tcpsocket[2].send(outbuffer, 10);
-            }
-        } else {
-            if (lanlink.type == 0) {
-                outbuffer[0] = 12;
-                WRITE16LE(&uint16_toutbuffer[4], cable_data[2]);
-                WRITE16LE(&uint16_toutbuffer[5], cable_data[3]);
-                tcpsocket[1].send(outbuffer, 12);
-                WRITE16LE(&uint16_toutbuffer[4], cable_data[1]);
-                tcpsocket[2].send(outbuffer, 12);
-                WRITE16LE(&uint16_toutbuffer[5], cable_data[2]);
-                tcpsocket[3].send(outbuffer, 12);
-            }
-        }
-    }
-    return;
-}
-
-// Receive data from all slaves to master
-void CableServer::Recv(void)
-{
-    int numbytes;
-    if (lanlink.type == 0) { // TCP
-        fdset.clear();
-
-        for (i = 0; i < lanlink.numslaves; i++)
-            fdset.add(tcpsocket[i + 1]);
-
-        if (fdset.wait(sf::milliseconds(50)) == 0) {
-            return;
-        }
-
-        for (i = 0; i < lanlink.numslaves; i++) {
-            numbytes = 0;
-            inbuffer[0] = 1;
-            while (numbytes < inbuffer[0]) {
-                size_t nr;
-                tcpsocket[i + 1].receive(inbuffer + numbytes, inbuffer[0] - numbytes, nr);
-                numbytes += nr;
-            }
-            if (inbuffer[1] == -32) {
-                char message[30];
-                sprintf(message, _("Player %d disconnected."), i + 2);
-                systemScreenMessage(message);
-                outbuffer[0] = 4;
-                outbuffer[1] = -32;
-                for (i = 1; i < lanlink.numslaves; i++) {
-                    tcpsocket[i].send(outbuffer, 12);
-                    size_t nr;
-                    tcpsocket[i].receive(inbuffer, 256, nr);
-                    tcpsocket[i].disconnect();
-                }
-                CloseLink();
-                return;
-            }
-            cable_data[i + 1] = READ16LE(&uint16_tinbuffer[1]);
-        }
-    }
-    return;
-}
-
 void CableServer::SendGB(void)
 {
     if (counter == 0)
@@ -911,36 +895,6 @@ CableClient::CableClient(void)
     return;
 }
 
-void CableClient::CheckConn(void)
-{
-    size_t nr;
-    lanlink.tcpsocket.receive(inbuffer, 1, nr);
-    numbytes = nr;
-    if (numbytes > 0) {
-        while (numbytes < inbuffer[0]) {
-            lanlink.tcpsocket.receive(inbuffer + numbytes, inbuffer[0] - numbytes, nr);
-            numbytes += nr;
-        }
-        if (inbuffer[1] == -32) {
-            outbuffer[0] = 4;
-            lanlink.tcpsocket.send(outbuffer, 4);
-            systemScreenMessage(_("Server disconnected."));
-            CloseLink();
-            return;
-        }
-        transferring = true;
-        transfer_start_time_from_master = 0;
-        cable_data[0] = READ16LE(&uint16_tinbuffer[1]);
-        tspeed = inbuffer[1] & 3;
-        for (i = 1, numbytes = 4; i <= lanlink.numslaves; i++)
-            if (i != linkid) {
-                cable_data[i] = READ16LE(&uint16_tinbuffer[numbytes]);
-                numbytes++;
-            }
-    }
-    return;
-}
-
 bool CableClient::RecvGB(void)
 {
     if (!transferring)
@@ -984,48 +938,192 @@ void CableClient::SendGB()
     transferring = true;
 }
 
-void CableClient::Recv(void)
+// Cable link over sockets
+//
+// Every machine counts the clock ticks it has emulated since the link came
+// up, and everything it sends is stamped with that count.  Records are
+// queued and sent in batches, every LINK_BATCH_TICKS or whenever the
+// sender is about to wait, instead of one packet and round trip per
+// transfer (see GBALinkRecords.h): slaves report each change of SIODATA8,
+// and the master sends each transfer off as it starts, stamped with its
+// tick and the values of all machines.  A slave's value is the one it
+// last reported, so it can be up to LINK_WINDOW_TICKS old; slaves play the
+// transfer back at the first instruction boundary at or after its tick,
+// and every machine sees the same values.
+//
+// Slaves never run past the last tick the master reported, since the
+// master may start a transfer there.  The master never waits for a
+// transfer; it only stops when the slowest slave falls more than
+// LINK_WINDOW_TICKS behind.  Waits give up after the link timeout and
+// carry on with what is known.  A machine that closes the link sends
+// CLOSE with its tick; its peers follow it up to there before letting go.
+
+// how long the master waits for a slave to answer with its version
+#define LINK_HANDSHAKE_MS 3000
+#define LINK_WINDOW_TICKS 280896 // one frame
+#define LINK_BATCH_TICKS (LINK_WINDOW_TICKS / 16)
+
+// master: slaves 1-3; slave: the master is peer 0
+static LinkPeer link_peers[4];
+static uint64_t link_ticks;
+static uint64_t link_next_batch;
+static int link_last_data; // slave: SIODATA8 last reported
+
+static sf::TcpSocket& LinkPeerSocket(int peer)
 {
-    fdset.clear();
-    // old code used socket # instead of mask again
-    fdset.add(lanlink.tcpsocket);
-    // old code stripped off ms again
-    if (fdset.wait(sf::milliseconds(50)) == 0) {
-        transferring = false;
-        return;
+    return linkid ? lanlink.tcpsocket : ls.tcpsocket[peer];
+}
+
+static void ResetCableSocket()
+{
+    for (int i = 0; i < 4; i++)
+        LinkPeerReset(link_peers[i]);
+
+    link_ticks = 0;
+    link_next_batch = 0;
+    link_last_data = -1;
+
+    // peers are polled from the emulation thread, which must never block
+    for (int i = 1; i <= lanlink.numslaves; i++)
+        ls.tcpsocket[i].setBlocking(false);
+}
+
+// sends what is queued for peer, or as much as the socket takes;
+// false if the connection is gone
+static bool LinkFlush(int peer)
+{
+    LinkPeer& p = link_peers[peer];
+
+    // a closing peer reads no more
+    if (p.closing)
+        p.out.clear();
+
+    while (!p.out.empty()) {
+        size_t sent = 0;
+        sf::Socket::Status status = LinkPeerSocket(peer).send(&p.out[0], p.out.size(), sent);
+
+        p.out.erase(p.out.begin(), p.out.begin() + sent);
+
+        if (status == sf::Socket::Error || status == sf::Socket::Disconnected)
+            return false;
+        if (status == sf::Socket::NotReady)
+            break; // rest goes with the next batch
     }
-    numbytes = 0;
-    inbuffer[0] = 1;
-    size_t nr;
-    while (numbytes < inbuffer[0]) {
-        lanlink.tcpsocket.receive(inbuffer + numbytes, inbuffer[0] - numbytes, nr);
-        numbytes += nr;
+
+    return true;
+}
+
+// reads and handles whatever peer has sent; false if the connection went
+// without a CLOSE
+static bool LinkReceive(int peer)
+{
+    LinkPeer& p = link_peers[peer];
+    sf::TcpSocket& socket = LinkPeerSocket(peer);
+    uint8_t buffer[1024];
+    bool open = true;
+
+    if (p.closing)
+        return true;
+
+    while (open) {
+        size_t nr = 0;
+        sf::Socket::Status status = socket.receive(buffer, sizeof(buffer), nr);
+
+        if (status == sf::Socket::Done)
+            p.in.insert(p.in.end(), buffer, buffer + nr);
+        else if (status == sf::Socket::NotReady)
+            break;
+        else
+            open = false;
     }
-    if (inbuffer[1] == -32) {
-        outbuffer[0] = 4;
-        lanlink.tcpsocket.send(outbuffer, 4);
+
+    // what came before the connection went still counts
+    LinkParse(p);
+
+    return open || p.closing;
+}
+
+static void LinkLost(int peer)
+{
+    if (linkid)
         systemScreenMessage(_("Server disconnected."));
-        CloseLink();
-        return;
+    else {
+        char message[30];
+        sprintf(message, _("Player %d disconnected."), peer + 1);
+        systemScreenMessage(message);
     }
-    tspeed = inbuffer[1] & 3;
-    cable_data[0] = READ16LE(&uint16_tinbuffer[1]);
-    transfer_start_time_from_master = (int32_t)READ32LE(&intinbuffer[1]);
-    for (i = 1, numbytes = 4; i < lanlink.numslaves + 1; i++) {
-        if (i != linkid) {
-            cable_data[i] = READ16LE(&uint16_tinbuffer[numbytes]);
-            numbytes++;
+
+    CloseLink();
+}
+
+// waits until peer has reported reaching tick or the link timeout passed;
+// false if the link was closed
+static bool LinkWaitFor(int peer, uint64_t tick)
+{
+    sf::SocketSelector fdset;
+    uint32_t start = systemGetClock();
+
+    fdset.add(LinkPeerSocket(peer));
+
+    while (link_peers[peer].tick < tick && !link_peers[peer].closing) {
+        if (!LinkFlush(peer))
+            return false;
+
+        int left = linktimeout - (int)(systemGetClock() - start);
+        if (left <= 0)
+            break;
+
+        fdset.wait(sf::milliseconds(left));
+
+        if (!LinkReceive(peer))
+            return false;
+    }
+
+    return true;
+}
+
+// sends and receives without waiting; false if the link was closed
+static bool PollCableSocket()
+{
+    int first = linkid ? 0 : 1;
+    int last = linkid ? 0 : lanlink.numslaves;
+
+    for (int peer = first; peer <= last; peer++) {
+        if (!LinkFlush(peer) || !LinkReceive(peer)) {
+            LinkLost(peer);
+            return false;
         }
     }
+
+    return true;
 }
 
-void CableClient::Send()
+// master: fills in the slave values for a transfer starting now and sends
+// it off without waiting for the slaves; false if the link was closed
+static bool SendCableTransfer()
 {
-    outbuffer[0] = 4;
-    outbuffer[1] = linkid << 2;
-    WRITE16LE(&uint16_toutbuffer[1], cable_data[linkid]);
-    lanlink.tcpsocket.send(outbuffer, 4);
-    return;
+    if (gba_connection_state != LINK_OK)
+        return true;
+
+    for (int i = 1; i <= lanlink.numslaves; i++) {
+        if (!LinkReceive(i)) {
+            LinkLost(i);
+            return false;
+        }
+
+        cable_data[i] = LinkDataAt(link_peers[i], link_ticks);
+    }
+
+    for (int i = 1; i <= lanlink.numslaves; i++) {
+        LinkQueue(link_peers[i], LINK_REC_TRANSFER, link_ticks, tspeed, cable_data);
+
+        if (!LinkFlush(i)) {
+            LinkLost(i);
+            return false;
+        }
+    }
+
+    return true;
 }
 
 static ConnectionState InitSocket()
@@ -1091,13 +1189,31 @@ static ConnectionState ConnectUpdateSocket(char* const message, size_t size)
             } else {
                 sf::Packet packet;
                 packet << static_cast<sf::Uint16>(nextSlave)
-                       << static_cast<sf::Uint16>(lanlink.numslaves);
+                       << static_cast<sf::Uint16>(lanlink.numslaves)
+                       << static_cast<sf::Uint16>(LINK_PROTOCOL_VERSION);
 
                 ls.tcpsocket[nextSlave].send(packet);
 
-                snprintf(message, size, N_("Player %d connected"), nextSlave);
+                // the slave answers with its protocol version; older clients
+                // send nothing and would misread the records, so drop them
+                sf::Uint16 slaveVersion = 0;
+                sf::SocketSelector reply;
+                reply.add(ls.tcpsocket[nextSlave]);
+                packet.clear();
 
-                lanlink.connectedSlaves++;
+                if (reply.wait(sf::milliseconds(LINK_HANDSHAKE_MS))
+                    && ls.tcpsocket[nextSlave].receive(packet) == sf::Socket::Done)
+                    packet >> slaveVersion;
+
+                if (!packet || slaveVersion != LINK_PROTOCOL_VERSION) {
+                    ls.tcpsocket[nextSlave].disconnect();
+
+                    snprintf(message, size, N_("Player %d uses a different link protocol"), nextSlave);
+                } else {
+                    snprintf(message, size, N_("Player %d connected"), nextSlave);
+
+                    lanlink.connectedSlaves++;
+                }
             }
         }
 
@@ -1123,13 +1239,20 @@ static ConnectionState ConnectUpdateSocket(char* const message, size_t size)
         } else if (status == sf::Socket::Done) {
 
             if (linkid == 0) {
-                sf::Uint16 receivedId, receivedSlaves;
-                packet >> receivedId >> receivedSlaves;
+                sf::Uint16 receivedId, receivedSlaves, receivedVersion;
+                packet >> receivedId >> receivedSlaves >> receivedVersion;
 
-                if (packet) {
+                if (!packet || receivedVersion != LINK_PROTOCOL_VERSION) {
+                    snprintf(message, size, N_("The server uses a different link protocol."));
+                    return LINK_ERROR;
+                } else {
                     linkid = receivedId;
                     lanlink.numslaves = receivedSlaves;
 
+                    sf::Packet reply;
+                    reply << static_cast<sf::Uint16>(LINK_PROTOCOL_VERSION);
+                    lanlink.tcpsocket.send(reply);
+
                     snprintf(message, size, N_("Connected as #%d, Waiting for %d players to join"),
                         linkid + 1, lanlink.numslaves - linkid);
                 }
@@ -1149,6 +1272,9 @@ static ConnectionState ConnectUpdateSocket(char* const message, size_t size)
         }
     }
 
+    if (newState == LINK_OK && linkDriver->mode == LINK_CABLE_SOCKET)
+        ResetCableSocket();
+
     return newState;
 }
 
@@ -1168,9 +1294,10 @@ void StartCableSocket(uint16_t value)
         }
         if (start) {
             cable_data[0] = READ16LE(&ioMem[COMM_SIODATA8]);
-            transfer_start_time_from_master = linktime;
             tspeed = value & 3;
-            ls.Send();
+            start = SendCableTransfer();
+        }
+        if (start) {
             transfer_direction = RECEIVING;
             linktime = 0;
             UPDATE_REG(COMM_SIOMULTI0, cable_data[0]);
@@ -1204,11 +1331,75 @@ void StartCableSocket(uint16_t value)
 
 static void UpdateCableSocket(int ticks)
 {
-    (void)ticks; // unused param
-    if (linkid && transfer_direction == SENDING && lc.transferring && linktime >= transfer_start_time_from_master) {
-        cable_data[linkid] = READ16LE(&ioMem[COMM_SIODATA8]);
+    if (gba_connection_state != LINK_OK)
+        return;
+
+    link_ticks += ticks;
+
+    if (linkid) {
+        uint16_t data[4] = { READ16LE(&ioMem[COMM_SIODATA8]) };
+
+        if (data[0] != link_last_data) {
+            link_last_data = data[0];
+            LinkQueue(link_peers[0], LINK_REC_DATA, link_ticks, 0, data);
+        }
+
+        if (link_peers[0].closing) {
+            // the last transfer may finish a little after the master's
+            if (LinkPeerDone(link_peers[0], link_ticks) && transfer_direction != RECEIVING) {
+                LinkLost(0);
+                return;
+            }
+        } else if (link_ticks >= link_peers[0].tick) {
+            LinkQueue(link_peers[0], LINK_REC_SYNC, link_ticks);
+
+            if (!LinkWaitFor(0, link_ticks + 1)) {
+                LinkLost(0);
+                return;
+            }
+
+            // timed out; don't stall again before the next window
+            if (link_peers[0].tick <= link_ticks && !link_peers[0].closing)
+                link_peers[0].tick = link_ticks + LINK_WINDOW_TICKS;
+        }
+    } else {
+        for (int i = 1; i <= lanlink.numslaves; i++) {
+            if (link_peers[i].closing) {
+                if (LinkPeerDone(link_peers[i], link_ticks)) {
+                    LinkLost(i);
+                    return;
+                }
+            } else if (link_ticks > link_peers[i].tick + LINK_WINDOW_TICKS) {
+                LinkQueue(link_peers[i], LINK_REC_SYNC, link_ticks);
+
+                if (!LinkWaitFor(i, link_ticks - LINK_WINDOW_TICKS)) {
+                    LinkLost(i);
+                    return;
+                }
+
+                // timed out; don't stall again before the next window
+                if (link_peers[i].tick < link_ticks - LINK_WINDOW_TICKS && !link_peers[i].closing)
+                    link_peers[i].tick = link_ticks;
+            }
+        }
+    }
+
+    if (link_ticks >= link_next_batch) {
+        link_next_batch = link_ticks + LINK_BATCH_TICKS;
+
+        for (int peer = linkid ? 0 : 1; peer <= (linkid ? 0 : lanlink.numslaves); peer++)
+            LinkQueue(link_peers[peer], LINK_REC_SYNC, link_ticks);
+
+        if (!PollCableSocket())
+            return;
+    }
+
+    LinkRecord transfer;
+    if (linkid && transfer_direction == SENDING && LinkTakeTransfer(link_peers[0], link_ticks, transfer)) {
+        tspeed = transfer.speed;
+        for (int i = 0; i < 4; i++)
+            cable_data[i] = transfer.values[i];
 
-        lc.Send();
         UPDATE_REG(COMM_SIODATA32_L, cable_data[0]);
         UPDATE_REG(COMM_SIOCNT, READ16LE(&ioMem[COMM_SIOCNT]) | 0x80);
         transfer_direction = RECEIVING;
@@ -1225,12 +1416,6 @@ static void UpdateCableSocket(int ticks)
         transfer_direction = SENDING;
         linktime -= trtimeend[lanlink.numslaves - 1][tspeed];
 
-        if (linkid) {
-            lc.transferring = true;
-            lc.Recv();
-        } else {
-            ls.Recv(); // Receive data from all of the slaves
-        }
         UPDATE_REG(COMM_SIOMULTI1, cable_data[1]);
         UPDATE_REG(COMM_SIOMULTI2, cable_data[2]);
         UPDATE_REG(COMM_SIOMULTI3, cable_data[3]);
@@ -1239,7 +1424,14 @@ static void UpdateCableSocket(int ticks)
 
 static void CloseSocket()
 {
-    if (linkid) {
+    if (linkDriver->mode == LINK_CABLE_SOCKET && gba_connection_state == LINK_OK) {
+        for (int peer = linkid ? 0 : 1; peer <= (linkid ? 0 : lanlink.numslaves); peer++) {
+            LinkQueue(link_peers[peer], LINK_REC_CLOSE, link_ticks);
+            LinkFlush(peer);
+        }
+        for (int i = 1; i <= lanlink.numslaves; i++)
+            ls.tcpsocket[i].disconnect();
+    } else if (linkid) {
         char outbuffer[4];
         outbuffer[0] = 4;
         outbuffer[1] = -32;
@@ -1267,11 +1459,13 @@ void CleanLocalLink()
 {
 #if !(defined __WIN32__ || defined _WIN32)
     shm_unlink("/" LOCAL_LINK_NAME);
+#ifndef __linux__
     for (int i = 0; i < 4; i++) {
         linkevent[sizeof(linkevent) - 2] = '1' + i;
         sem_unlink(linkevent);
     }
 #endif
+#endif
 }
 
 static ConnectionState JoyBusConnect()
@@ -2578,7 +2772,7 @@ uint16_t gbLinkUpdate(uint8_t b, int gbSerialOn) //used on external clock
     return ((dat << 8) | (recvd & (uint8_t)0xff));
 }
 
-#if (defined __WIN32__ || defined _WIN32)
+#ifdef LINK_IPC
 
 static ConnectionState InitIPC()
 {
@@ -2606,14 +2800,20 @@ static ConnectionState InitIPC()
         mmf = shm_open("/" LOCAL_LINK_NAME, O_RDWR, 0);
     } else
         vbaid = 0;
-    if (mmf < 0 || ftruncate(mmf, sizeof(LINKDATA)) < 0 || !(linkmem = (LINKDATA*)mmap(NULL, sizeof(LINKDATA), PROT_READ | PROT_WRITE, MAP_SHARED, mmf, 0))) {
+    void* map = MAP_FAILED;
+    if (mmf >= 0 && ftruncate(mmf, sizeof(LINKDATA)) == 0)
+        map = mmap(NULL, sizeof(LINKDATA), PROT_READ | PROT_WRITE, MAP_SHARED, mmf, 0);
+    if (map == MAP_FAILED) {
+        linkmem = NULL;
         systemMessage(0, N_("Error creating file mapping"));
-        if (mmf) {
+        if (mmf >= 0) {
             if (!vbaid)
                 shm_unlink("/" LOCAL_LINK_NAME);
             close(mmf);
         }
+        return LINK_ERROR;
     }
+    linkmem = (LINKDATA*)map;
 #endif
 
     // get lowest-numbered available machine slot
@@ -2666,6 +2866,10 @@ static ConnectionState InitIPC()
             systemMessage(0, N_("Error opening event"));
             return LINK_ERROR;
         }
+#elif defined(__linux__)
+        linksync[i] = &linkmem->linksem[i];
+        if (firstone)
+            ResetSemaphore(linksync[i]);
 #else
         if ((linksync[i] = sem_open(linkevent,
                  firstone ? O_CREAT | O_EXCL : 0,
@@ -2695,12 +2899,12 @@ static void StartCableIPC(uint16_t value)
 {
     switch (GetSIOMode(value, READ16LE(&ioMem[COMM_RCNT]))) {
     case MULTIPLAYER: {
-        bool start = (value & 0x80) && !linkid && !transfer_direction;
+        bool start = (value & 0x80) && !linkid && !ipc_transfer;
         // clear start, seqno, si (RO on slave, start = pulse on master)
         value &= 0xff4b;
         // get current si.  This way, on slaves, it is low during xfer
         if (linkid) {
-            if (!transfer_direction)
+            if (!ipc_transfer)
                 value |= 4;
             else
                 value |= READ16LE(&ioMem[COMM_SIOCNT]) & 4;
@@ -2724,8 +2928,12 @@ static void StartCableIPC(uint16_t value)
                 // this will fail if a slave was stuck for
                 // too long
                 for (int i = 0; i < 4; i++)
+#ifdef __linux__
+                    ResetSemaphore(linksync[i]);
+#else
                     while (WaitForSingleObject(linksync[i], 0) != WAIT_TIMEOUT)
                         ;
+#endif
 
                 // transmit first value
                 linkmem->linkcmd[0] = ('M' << 8) + (value & 3);
@@ -2743,7 +2951,7 @@ static void StartCableIPC(uint16_t value)
                 else
                     linkmem->numtransfers = numtransfers;
 
-                transfer_direction = 1;
+                ipc_transfer = 1;
                 linktime = 0;
                 tspeed = value & 3;
                 WRITE32LE(&ioMem[COMM_SIOMULTI0], 0xffffffff);
@@ -2753,19 +2961,19 @@ static void StartCableIPC(uint16_t value)
                 value |= 0x40; // comm error
             }
         }
-        value |= (transfer_direction != 0) << 7;
-        value |= (linkid && !transfer_direction ? 0xc : 8); // set SD (high), SI (low on master)
+        value |= (ipc_transfer != 0) << 7;
+        value |= (linkid && !ipc_transfer ? 0xc : 8); // set SD (high), SI (low on master)
         value |= linkid << 4; // set seq
         UPDATE_REG(COMM_SIOCNT, value);
         if (linkid)
             // SC low -> transfer in progress
             // not sure why SO is low
-            UPDATE_REG(COMM_RCNT, transfer_direction ? 6 : 7);
+            UPDATE_REG(COMM_RCNT, ipc_transfer ? 6 : 7);
         else
             // SI is always low on master
             // SO, SC always low during transfer
             // not sure why SO low otherwise
-            UPDATE_REG(COMM_RCNT, transfer_direction ? 2 : 3);
+            UPDATE_REG(COMM_RCNT, ipc_transfer ? 2 : 3);
         break;
     }
     case NORMAL8:
@@ -2801,13 +3009,13 @@ static void UpdateCableIPC(int ticks)
     // and syncing clock with master (after first transfer)
     // this will fail if > ~2 minutes have passed since last transfer due
     // to integer overflow
-    if (!transfer_direction && numtransfers && linktime < 0) {
+    if (!ipc_transfer && numtransfers && linktime < 0) {
         linktime = 0;
         // there is a very, very, small chance that this will abort
         // a transfer that was just started
         linkmem->numtransfers = numtransfers = 0;
     }
-    if (linkid && !transfer_direction && linktime >= linkmem->lastlinktime && linkmem->numtransfers != numtransfers) {
+    if (linkid && !ipc_transfer && linktime >= linkmem->lastlinktime && linkmem->numtransfers != numtransfers) {
         numtransfers = linkmem->numtransfers;
         if (!numtransfers)
             return;
@@ -2815,7 +3023,7 @@ static void UpdateCableIPC(int ticks)
         // if this or any previous machine was dropped, no transfer
         // can take place
         if (linkmem->trgbas <= linkid) {
-            transfer_direction = 0;
+            ipc_transfer = 0;
             numtransfers = 0;
             // if this is the one that was dropped, reconnect
             if (!(linkmem->linkflags & (1 << linkid)))
@@ -2837,7 +3045,7 @@ static void UpdateCableIPC(int ticks)
 		case 'M':
 #endif
         tspeed = linkmem->linkcmd[0] & 3;
-        transfer_direction = 1;
+        ipc_transfer = 1;
         WRITE32LE(&ioMem[COMM_SIOMULTI0], 0xffffffff);
         WRITE32LE(&ioMem[COMM_SIOMULTI2], 0xffffffff);
         UPDATE_REG(COMM_SIOCNT, READ16LE(&ioMem[COMM_SIOCNT]) & ~0x40 | 0x80);
@@ -2847,38 +3055,38 @@ static void UpdateCableIPC(int ticks)
 #endif
     }
 
-    if (!transfer_direction)
+    if (!ipc_transfer)
         return;
 
-    if (transfer_direction <= linkmem->trgbas && linktime >= trtimedata[transfer_direction - 1][tspeed]) {
+    if (ipc_transfer <= linkmem->trgbas && linktime >= trtimedata[ipc_transfer - 1][tspeed]) {
         // transfer #n -> wait for value n - 1
-        if (transfer_direction > 1 && linkid != transfer_direction - 1) {
-            if (WaitForSingleObject(linksync[transfer_direction - 1], linktimeout) == WAIT_TIMEOUT) {
+        if (ipc_transfer > 1 && linkid != ipc_transfer - 1) {
+            if (WaitForSingleObject(linksync[ipc_transfer - 1], linktimeout) == WAIT_TIMEOUT) {
                 // assume slave has dropped off if timed out
                 if (!linkid) {
-                    linkmem->trgbas = transfer_direction - 1;
+                    linkmem->trgbas = ipc_transfer - 1;
                     int f = linkmem->linkflags;
-                    f &= ~(1 << (transfer_direction - 1));
+                    f &= ~(1 << (ipc_transfer - 1));
                     linkmem->linkflags = f;
-                    if (f < (1 << transfer_direction) - 1)
-                        linkmem->numgbas = transfer_direction - 1;
+                    if (f < (1 << ipc_transfer) - 1)
+                        linkmem->numgbas = ipc_transfer - 1;
                     char message[30];
-                    sprintf(message, _("Player %d disconnected."), transfer_direction - 1);
+                    sprintf(message, _("Player %d disconnected."), ipc_transfer - 1);
                     systemScreenMessage(message);
                 }
-                transfer_direction = linkmem->trgbas + 1;
+                ipc_transfer = linkmem->trgbas + 1;
                 // next cycle, transfer will finish up
                 return;
             }
         }
         // now that value is available, store it
-        UPDATE_REG((COMM_SIOMULTI0 - 2) + (transfer_direction << 1), linkmem->linkdata[transfer_direction - 1]);
+        UPDATE_REG((COMM_SIOMULTI0 - 2) + (ipc_transfer << 1), linkmem->linkdata[ipc_transfer - 1]);
 
         // transfer machine's value at start of its transfer cycle
-        if (linkid == transfer_direction) {
+        if (linkid == ipc_transfer) {
             // skip if dropped
             if (linkmem->trgbas <= linkid) {
-                transfer_direction = 0;
+                ipc_transfer = 0;
                 numtransfers = 0;
                 // if this is the one that was dropped, reconnect
                 if (!(linkmem->linkflags & (1 << linkid)))
@@ -2891,22 +3099,22 @@ static void UpdateCableIPC(int ticks)
             linkmem->linkdata[linkid] = READ16LE(&ioMem[COMM_SIODATA8]);
             ReleaseSemaphore(linksync[linkid], linkmem->numgbas - 1, NULL);
         }
-        if (linkid == transfer_direction - 1) {
+        if (linkid == ipc_transfer - 1) {
             // SO becomes low to begin next trasnfer
             // may need to set DDR as well
             UPDATE_REG(COMM_RCNT, 0x22);
         }
 
         // next cycle
-        transfer_direction = !transfer_direction;
+        ipc_transfer++;
     }
 
-    if (transfer_direction > linkmem->trgbas && linktime >= trtimeend[transfer_direction - 3][tspeed]) {
+    if (ipc_transfer > linkmem->trgbas && linktime >= trtimeend[ipc_transfer - 3][tspeed]) {
         // wait for slaves to finish
         // this keeps unfinished slaves from screwing up last xfer
         // not strictly necessary; may just slow things down
         if (!linkid) {
-            for (int i = 2; i < transfer_direction; i++)
+            for (int i = 2; i < ipc_transfer; i++)
                 if (WaitForSingleObject(linksync[0], linktimeout) == WAIT_TIMEOUT) {
                     // impossible to determine which slave died
                     // so leave them alone for now
@@ -2917,8 +3125,8 @@ static void UpdateCableIPC(int ticks)
         } else if (linkmem->trgbas > linkid)
             // signal master that this slave is finished
             ReleaseSemaphore(linksync[0], 1, NULL);
-        linktime -= trtimeend[transfer_direction - 3][tspeed];
-        transfer_direction = 0;
+        linktime -= trtimeend[ipc_transfer - 3][tspeed];
+        ipc_transfer = 0;
         uint16_t value = READ16LE(&ioMem[COMM_SIOCNT]);
         if (!linkid)
             value |= 4; // SI becomes high on slaves after xfer
@@ -2932,6 +3140,8 @@ static void UpdateCableIPC(int ticks)
     }
 }
 
+#if (defined __WIN32__ || defined _WIN32)
+
 // The GBA wireless RFU (see adapter3.txt)
 static void StartRFU(uint16_t value)
 {
@@ -4085,6 +4295,8 @@ uint16_t gbLinkUpdateIPC(uint8_t b, int gbSerialOn) //used on external clock
     return ((dat << 8) | (recvd & (uint8_t)0xff));
 }
 
+#endif // RFU and GB IPC
+
 static void CloseIPC()
 {
     int f = linkmem->linkflags;
@@ -4092,7 +4304,7 @@ static void CloseIPC()
     if (f & 0xf) {
         linkmem->linkflags = f;
         int n = linkmem->numgbas;
-        for (int i = 0; i < n; i--)
+        for (int i = 0; i < n; i++)
             if (f <= (1 << (i + 1)) - 1) {
                 linkmem->numgbas = i + 1;
                 break;
@@ -4104,6 +4316,10 @@ static void CloseIPC()
 #if (defined __WIN32__ || defined _WIN32)
             ReleaseSemaphore(linksync[i], 1, NULL);
             CloseHandle(linksync[i]);
+#elif defined(__linux__)
+            // wake anyone still waiting on this machine
+            ReleaseSemaphore(linksync[i], 1, NULL);
+            linksync[i] = NULL;
 #else
             sem_close(linksync[i]);
             if (!(f & 0xf)) {
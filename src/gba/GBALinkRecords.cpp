@@ -0,0 +1,98 @@
+#include <string.h>
+
+#include "../common/Port.h"
+#include "GBALinkRecords.h"
+
+void LinkPeerReset(LinkPeer& p)
+{
+    p.in.clear();
+    p.out.clear();
+    p.records.clear();
+    p.tick = 0;
+    p.data = 0xffff;
+    p.closing = false;
+}
+
+void LinkQueue(LinkPeer& p, uint8_t type, uint64_t tick, uint8_t speed, const uint16_t* values)
+{
+    uint32_t record[LINK_RECORD_SIZE / 4] = { 0 };
+    uint8_t* b = (uint8_t*)record;
+
+    b[0] = type;
+    b[1] = speed;
+    WRITE32LE(&record[1], (uint32_t)tick);
+    WRITE32LE(&record[2], (uint32_t)(tick >> 32));
+    if (values)
+        for (int v = 0; v < 4; v++)
+            WRITE16LE(&b[12 + v * 2], values[v]);
+
+    p.out.insert(p.out.end(), b, b + LINK_RECORD_SIZE);
+}
+
+void LinkParse(LinkPeer& p)
+{
+    size_t pos;
+    for (pos = 0; pos + LINK_RECORD_SIZE <= p.in.size() && !p.closing; pos += LINK_RECORD_SIZE) {
+        uint32_t record[LINK_RECORD_SIZE / 4];
+        uint8_t* b = (uint8_t*)record;
+        LinkRecord rec;
+
+        memcpy(record, &p.in[pos], LINK_RECORD_SIZE);
+        rec.type = b[0];
+        rec.speed = b[1] & 3;
+        rec.tick = READ32LE(&record[1]) | ((uint64_t)READ32LE(&record[2]) << 32);
+        for (int v = 0; v < 4; v++)
+            rec.values[v] = READ16LE(&b[12 + v * 2]);
+
+        switch (rec.type) {
+        case LINK_REC_DATA:
+        case LINK_REC_TRANSFER:
+            p.records.push_back(rec);
+            break;
+        case LINK_REC_CLOSE:
+            p.closing = true;
+            break;
+        }
+
+        if (rec.tick > p.tick)
+            p.tick = rec.tick;
+    }
+
+    // nothing follows CLOSE
+    if (p.closing)
+        pos = p.in.size();
+    p.in.erase(p.in.begin(), p.in.begin() + pos);
+}
+
+uint16_t LinkDataAt(LinkPeer& p, uint64_t tick)
+{
+    while (!p.records.empty() && p.records.front().tick <= tick) {
+        p.data = p.records.front().values[0];
+        p.records.pop_front();
+    }
+
+    return p.data;
+}
+
+bool LinkTakeTransfer(LinkPeer& p, uint64_t tick, LinkRecord& transfer)
+{
+    if (p.records.empty() || p.records.front().tick > tick)
+        return false;
+
+    transfer = p.records.front();
+    p.records.pop_front();
+    return true;
+}
+
+bool LinkPeerDone(const LinkPeer& p, uint64_t tick)
+{
+    if (!p.closing || tick < p.tick)
+        return false;
+
+    // DATA records past the last transfer are never needed
+    for (size_t i = 0; i < p.records.size(); i++)
+        if (p.records[i].type == LINK_REC_TRANSFER)
+            return false;
+
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef GBA_GBALINKRECORDS_H
+#define GBA_GBALINKRECORDS_H
+
+#include <deque>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+// The records exchanged by the cable link over sockets, and what each side
+// keeps of its peers' records.  Nothing here touches a socket: GBALink.cpp
+// moves the bytes, and describes the protocol.
+
+// bump when the records below change
+#define LINK_PROTOCOL_VERSION 2
+#define LINK_RECORD_SIZE 20
+
+// record layout, little endian: 0 type, 1 speed, 4-11 tick, 12-19 values
+enum {
+    LINK_REC_SYNC = 1, // sender has emulated up to tick
+    LINK_REC_DATA, // slave SIODATA8 is values[0] from tick on
+    LINK_REC_TRANSFER, // transfer started at tick, values of all machines
+    LINK_REC_CLOSE // sender stopped at tick
+};
+
+struct LinkRecord {
+    uint8_t type;
+    uint8_t speed;
+    uint64_t tick;
+    uint16_t values[4];
+};
+
+struct LinkPeer {
+    std::vector<uint8_t> in, out;
+    // DATA records (master) or TRANSFER records (slave) not used yet
+    std::deque<LinkRecord> records;
+    uint64_t tick; // peer has emulated this far
+    uint16_t data; // master: slave SIODATA8 as of the last used record
+    bool closing; // peer stopped at tick; its records up to there still count
+};
+
+void LinkPeerReset(LinkPeer& p);
+// appends a record to p.out
+void LinkQueue(LinkPeer& p, uint8_t type, uint64_t tick, uint8_t speed = 0, const uint16_t* values = NULL);
+// takes in the whole records in p.in, leaving the start of any other
+void LinkParse(LinkPeer& p);
+// master: slave SIODATA8 at tick, as far as the slave has reported it
+uint16_t LinkDataAt(LinkPeer& p, uint64_t tick);
+// slave: takes the first transfer started at or before tick, if any
+bool LinkTakeTransfer(LinkPeer& p, uint64_t tick, LinkRecord& transfer);
+// a closing peer has been followed up to tick and has nothing left to play
+bool LinkPeerDone(const LinkPeer& p, uint64_t tick);
+
+#endif // GBA_GBALINKRECORDS_H
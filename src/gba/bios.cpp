@@ -250,6 +250,72 @@ void BIOS_BgAffineSet()
     }
 }
 
+// A run of plain memory the SWIs below read or write directly; addresses
+// outside it, or everything when it isn't plain, go through the bus.
+struct BiosRange {
+    uint8_t* memory;
+    uint32_t mask;
+    uint32_t start;
+    uint32_t size;
+};
+
+static void biosRange(BiosRange& r, uint32_t address, uint32_t size, uint32_t unit, bool write)
+{
+    r.memory = NULL;
+    r.start = address;
+    r.size = 0;
+    if (size >= unit)
+        r.memory = dmaPlainMemory(address, unit, size / unit, unit, write, r.mask);
+    // byte writes to palette, VRAM and OAM aren't plain stores
+    if (r.memory && write && unit == 1 && r.memory != workRAM && r.memory != internalRAM)
+        r.memory = NULL;
+#ifdef BKPT_SUPPORT
+    // the LZ77 window reads the output back; honour read breakpoints too
+    if (r.memory && write && !dmaPlainMemory(address, unit, size / unit, unit, false, r.mask))
+        r.memory = NULL;
+#endif
+    if (r.memory)
+        r.size = size / unit * unit;
+}
+
+static inline uint8_t biosReadByte(const BiosRange& r, uint32_t address)
+{
+    if (address - r.start < r.size)
+        return r.memory[address & r.mask];
+    return CPUReadByte(address);
+}
+
+static inline uint32_t biosReadMemory(const BiosRange& r, uint32_t address)
+{
+    if (address - r.start < r.size && !(address & 3))
+        return READ32LE((uint32_t*)&r.memory[address & r.mask]);
+    return CPUReadMemory(address);
+}
+
+static inline void biosWriteByte(const BiosRange& r, uint32_t address, uint8_t value)
+{
+    if (address - r.start < r.size)
+        r.memory[address & r.mask] = value;
+    else
+        CPUWriteByte(address, value);
+}
+
+static inline void biosWriteHalfWord(const BiosRange& r, uint32_t address, uint16_t value)
+{
+    if (address - r.start < r.size)
+        WRITE16LE((uint16_t*)&r.memory[address & r.mask & ~1], value);
+    else
+        CPUWriteHalfWord(address, value);
+}
+
+static inline void biosWriteMemory(const BiosRange& r, uint32_t address, uint32_t value)
+{
+    if (address - r.start < r.size)
+        WRITE32LE((uint32_t*)&r.memory[address & r.mask & ~3], value);
+    else
+        CPUWriteMemory(address, value);
+}
+
 void BIOS_CpuSet()
 {
 #ifdef GBA_LOGGING
@@ -267,21 +333,35 @@ void BIOS_CpuSet()
         return;
 
     int count = cnt & 0x1FFFFF;
+    uint32_t sMask, dMask;
+    uint8_t* dst;
+    const uint8_t* src;
 
     // 32-bit ?
     if ((cnt >> 26) & 1) {
         // needed for 32-bit mode!
         source &= 0xFFFFFFFC;
         dest &= 0xFFFFFFFC;
+        dst = count ? dmaPlainMemory(dest, 4, count, 4, true, dMask) : NULL;
         // fill ?
         if ((cnt >> 24) & 1) {
             uint32_t value = (source > 0x0EFFFFFF ? 0x1CAD1CAD : CPUReadMemory(source));
+            if (dst) {
+                dMask &= ~3;
+                for (; count; count--, dest += 4)
+                    WRITE32LE((uint32_t*)&dst[dest & dMask], value);
+            }
             while (count) {
                 CPUWriteMemory(dest, value);
                 dest += 4;
                 count--;
             }
         } else {
+            src = dst ? dmaPlainMemory(source, 4, count, 4, false, sMask) : NULL;
+            if (src) {
+                dmaCopyPlain(dst, dest, dMask, 4, src, source, sMask, 4, count, 4);
+                return;
+            }
             // copy
             while (count) {
                 CPUWriteMemory(dest, (source > 0x0EFFFFFF ? 0x1CAD1CAD : CPUReadMemory(source)));
@@ -291,15 +371,27 @@ void BIOS_CpuSet()
             }
         }
     } else {
+        dst = count ? dmaPlainMemory(dest & ~1, 2, count, 2, true, dMask) : NULL;
         // 16-bit fill?
         if ((cnt >> 24) & 1) {
             uint16_t value = (source > 0x0EFFFFFF ? 0x1CAD : CPUReadHalfWord(source));
+            if (dst) {
+                dMask &= ~1;
+                for (; count; count--, dest += 2)
+                    WRITE16LE((uint16_t*)&dst[dest & dMask], value);
+            }
             while (count) {
                 CPUWriteHalfWord(dest, value);
                 dest += 2;
                 count--;
             }
         } else {
+            // an odd source reads rotated halfwords, leave that to the bus
+            src = (dst && !(source & 1)) ? dmaPlainMemory(source, 2, count, 2, false, sMask) : NULL;
+            if (src) {
+                dmaCopyPlain(dst, dest, dMask, 2, src, source, sMask, 2, count, 2);
+                return;
+            }
             // copy
             while (count) {
                 CPUWriteHalfWord(dest, (source > 0x0EFFFFFF ? 0x1CAD : CPUReadHalfWord(source)));
@@ -332,9 +424,20 @@ void BIOS_CpuFastSet()
     dest &= 0xFFFFFFFC;
 
     int count = cnt & 0x1FFFFF;
+    // whole blocks of 8 words
+    uint32_t words = (count + 7) & ~7;
+    uint32_t sMask, dMask;
+    uint8_t* dst = words ? dmaPlainMemory(dest, 4, words, 4, true, dMask) : NULL;
 
     // fill?
     if ((cnt >> 24) & 1) {
+        for (; dst && count > 0; count -= 8) {
+            uint32_t value = (source > 0x0EFFFFFF ? 0xBAFFFFFB : CPUReadMemory(source));
+            for (int i = 0; i < 8; i++) {
+                WRITE32LE((uint32_t*)&dst[dest & dMask & ~3], value);
+                dest += 4;
+            }
+        }
         while (count > 0) {
             // BIOS always transfers 32 bytes at a time
             uint32_t value = (source > 0x0EFFFFFF ? 0xBAFFFFFB : CPUReadMemory(source));
@@ -345,6 +448,11 @@ void BIOS_CpuFastSet()
             count -= 8;
         }
     } else {
+        const uint8_t* src = dst ? dmaPlainMemory(source, 4, words, 4, false, sMask) : NULL;
+        if (src) {
+            dmaCopyPlain(dst, dest, dMask, 4, src, source, sMask, 4, words, 4);
+            return;
+        }
         // copy
         while (count > 0) {
             // BIOS always transfers 32 bytes at a time
@@ -542,12 +650,18 @@ void BIOS_HuffUnComp()
 
     int len = header >> 8;
 
+    // the tree, and a bit per output bit after it; codes can be longer
+    // than the data they stand for, and reads past this go to CPURead*
+    BiosRange in, out;
+    biosRange(in, treeStart - 1, source - treeStart + 1 + len + 4, 1, false);
+    biosRange(out, dest & ~3, len & ~3, 4, true);
+
     uint32_t mask = 0x80000000;
-    uint32_t data = CPUReadMemory(source);
+    uint32_t data = biosReadMemory(in, source);
     source += 4;
 
     int pos = 0;
-    uint8_t rootNode = CPUReadByte(treeStart);
+    uint8_t rootNode = biosReadByte(in, treeStart);
     uint8_t currentNode = rootNode;
     bool writeData = false;
     int byteShift = 0;
@@ -566,12 +680,12 @@ void BIOS_HuffUnComp()
                 // right
                 if (currentNode & 0x40)
                     writeData = true;
-                currentNode = CPUReadByte(treeStart + pos + 1);
+                currentNode = biosReadByte(in, treeStart + pos + 1);
             } else {
                 // left
                 if (currentNode & 0x80)
                     writeData = true;
-                currentNode = CPUReadByte(treeStart + pos);
+                currentNode = biosReadByte(in, treeStart + pos);
             }
 
             if (writeData) {
@@ -586,7 +700,7 @@ void BIOS_HuffUnComp()
                 if (byteCount == 4) {
                     byteCount = 0;
                     byteShift = 0;
-                    CPUWriteMemory(dest, writeValue);
+                    biosWriteMemory(out, dest, writeValue);
                     writeValue = 0;
                     dest += 4;
                     len -= 4;
@@ -595,7 +709,7 @@ void BIOS_HuffUnComp()
             mask >>= 1;
             if (mask == 0) {
                 mask = 0x80000000;
-                data = CPUReadMemory(source);
+                data = biosReadMemory(in, source);
                 source += 4;
             }
         }
@@ -613,12 +727,12 @@ void BIOS_HuffUnComp()
                 // right
                 if (currentNode & 0x40)
                     writeData = true;
-                currentNode = CPUReadByte(treeStart + pos + 1);
+                currentNode = biosReadByte(in, treeStart + pos + 1);
             } else {
                 // left
                 if (currentNode & 0x80)
                     writeData = true;
-                currentNode = CPUReadByte(treeStart + pos);
+                currentNode = biosReadByte(in, treeStart + pos);
             }
 
             if (writeData) {
@@ -639,7 +753,7 @@ void BIOS_HuffUnComp()
                     if (byteCount == 4) {
                         byteCount = 0;
                         byteShift = 0;
-                        CPUWriteMemory(dest, writeValue);
+                        biosWriteMemory(out, dest, writeValue);
                         dest += 4;
                         writeValue = 0;
                         len -= 4;
@@ -652,7 +766,7 @@ void BIOS_HuffUnComp()
             mask >>= 1;
             if (mask == 0) {
                 mask = 0x80000000;
-                data = CPUReadMemory(source);
+                data = biosReadMemory(in, source);
                 source += 4;
             }
         }
@@ -685,24 +799,29 @@ void BIOS_LZ77UnCompVram()
 
     int len = header >> 8;
 
+    // a flag byte per eight output bytes at worst
+    BiosRange in, out;
+    biosRange(in, source, len + len / 8 + 1, 1, false);
+    biosRange(out, dest & ~1, len & ~1, 2, true);
+
     while (len > 0) {
-        uint8_t d = CPUReadByte(source++);
+        uint8_t d = biosReadByte(in, source++);
 
         if (d) {
             for (int i = 0; i < 8; i++) {
                 if (d & 0x80) {
-                    uint16_t data = CPUReadByte(source++) << 8;
-                    data |= CPUReadByte(source++);
+                    uint16_t data = biosReadByte(in, source++) << 8;
+                    data |= biosReadByte(in, source++);
                     int length = (data >> 12) + 3;
                     int offset = (data & 0x0FFF);
                     uint32_t windowOffset = dest + byteCount - offset - 1;
                     for (int i2 = 0; i2 < length; i2++) {
-                        writeValue |= (CPUReadByte(windowOffset++) << byteShift);
+                        writeValue |= (biosReadByte(out, windowOffset++) << byteShift);
                         byteShift += 8;
                         byteCount++;
 
                         if (byteCount == 2) {
-                            CPUWriteHalfWord(dest, writeValue);
+                            biosWriteHalfWord(out, dest, writeValue);
                             dest += 2;
                             byteCount = 0;
                             byteShift = 0;
@@ -713,11 +832,11 @@ void BIOS_LZ77UnCompVram()
                             return;
                     }
                 } else {
-                    writeValue |= (CPUReadByte(source++) << byteShift);
+                    writeValue |= (biosReadByte(in, source++) << byteShift);
                     byteShift += 8;
                     byteCount++;
                     if (byteCount == 2) {
-                        CPUWriteHalfWord(dest, writeValue);
+                        biosWriteHalfWord(out, dest, writeValue);
                         dest += 2;
                         byteCount = 0;
                         byteShift = 0;
@@ -731,11 +850,11 @@ void BIOS_LZ77UnCompVram()
             }
         } else {
             for (int i = 0; i < 8; i++) {
-                writeValue |= (CPUReadByte(source++) << byteShift);
+                writeValue |= (biosReadByte(in, source++) << byteShift);
                 byteShift += 8;
                 byteCount++;
                 if (byteCount == 2) {
-                    CPUWriteHalfWord(dest, writeValue);
+                    biosWriteHalfWord(out, dest, writeValue);
                     dest += 2;
                     byteShift = 0;
                     byteCount = 0;
@@ -769,25 +888,30 @@ void BIOS_LZ77UnCompWram()
 
     int len = header >> 8;
 
+    // a flag byte per eight output bytes at worst
+    BiosRange in, out;
+    biosRange(in, source, len + len / 8 + 1, 1, false);
+    biosRange(out, dest, len, 1, true);
+
     while (len > 0) {
-        uint8_t d = CPUReadByte(source++);
+        uint8_t d = biosReadByte(in, source++);
 
         if (d) {
             for (int i = 0; i < 8; i++) {
                 if (d & 0x80) {
-                    uint16_t data = CPUReadByte(source++) << 8;
-                    data |= CPUReadByte(source++);
+                    uint16_t data = biosReadByte(in, source++) << 8;
+                    data |= biosReadByte(in, source++);
                     int length = (data >> 12) + 3;
                     int offset = (data & 0x0FFF);
                     uint32_t windowOffset = dest - offset - 1;
                     for (int i2 = 0; i2 < length; i2++) {
-                        CPUWriteByte(dest++, CPUReadByte(windowOffset++));
+                        biosWriteByte(out, dest++, biosReadByte(out, windowOffset++));
                         len--;
                         if (len == 0)
                             return;
                     }
                 } else {
-                    CPUWriteByte(dest++, CPUReadByte(source++));
+                    biosWriteByte(out, dest++, biosReadByte(in, source++));
                     len--;
                     if (len == 0)
                         return;
@@ -796,7 +920,7 @@ void BIOS_LZ77UnCompWram()
             }
         } else {
             for (int i = 0; i < 8; i++) {
-                CPUWriteByte(dest++, CPUReadByte(source++));
+                biosWriteByte(out, dest++, biosReadByte(in, source++));
                 len--;
                 if (len == 0)
                     return;
@@ -960,15 +1084,20 @@ void BIOS_RLUnCompVram()
         return;
 
     int len = header >> 8;
+
+    // a flag byte per 128 output bytes at worst
+    BiosRange in, out;
+    biosRange(in, source, len + len / 128 + 1, 1, false);
+    biosRange(out, dest & ~1, len & ~1, 2, true);
     int byteCount = 0;
     int byteShift = 0;
     uint32_t writeValue = 0;
 
     while (len > 0) {
-        uint8_t d = CPUReadByte(source++);
+        uint8_t d = biosReadByte(in, source++);
         int l = d & 0x7F;
         if (d & 0x80) {
-            uint8_t data = CPUReadByte(source++);
+            uint8_t data = biosReadByte(in, source++);
             l += 3;
             for (int i = 0; i < l; i++) {
                 writeValue |= (data << byteShift);
@@ -976,7 +1105,7 @@ void BIOS_RLUnCompVram()
                 byteCount++;
 
                 if (byteCount == 2) {
-                    CPUWriteHalfWord(dest, writeValue);
+                    biosWriteHalfWord(out, dest, writeValue);
                     dest += 2;
                     byteCount = 0;
                     byteShift = 0;
@@ -989,11 +1118,11 @@ void BIOS_RLUnCompVram()
         } else {
             l++;
             for (int i = 0; i < l; i++) {
-                writeValue |= (CPUReadByte(source++) << byteShift);
+                writeValue |= (biosReadByte(in, source++) << byteShift);
                 byteShift += 8;
                 byteCount++;
                 if (byteCount == 2) {
-                    CPUWriteHalfWord(dest, writeValue);
+                    biosWriteHalfWord(out, dest, writeValue);
                     dest += 2;
                     byteCount = 0;
                     byteShift = 0;
@@ -1029,14 +1158,19 @@ void BIOS_RLUnCompWram()
 
     int len = header >> 8;
 
+    // a flag byte per 128 output bytes at worst
+    BiosRange in, out;
+    biosRange(in, source, len + len / 128 + 1, 1, false);
+    biosRange(out, dest, len, 1, true);
+
     while (len > 0) {
-        uint8_t d = CPUReadByte(source++);
+        uint8_t d = biosReadByte(in, source++);
         int l = d & 0x7F;
         if (d & 0x80) {
-            uint8_t data = CPUReadByte(source++);
+            uint8_t data = biosReadByte(in, source++);
             l += 3;
             for (int i = 0; i < l; i++) {
-                CPUWriteByte(dest++, data);
+                biosWriteByte(out, dest++, data);
                 len--;
                 if (len == 0)
                     return;
@@ -1044,7 +1178,7 @@ void BIOS_RLUnCompWram()
         } else {
             l++;
             for (int i = 0; i < l; i++) {
-                CPUWriteByte(dest++, CPUReadByte(source++));
+                biosWriteByte(out, dest++, biosReadByte(in, source++));
                 len--;
                 if (len == 0)
                     return;
@@ -1215,15 +1349,15 @@ static int32_t BIOS_SndDriver_3e4(uint32_t const r0a, uint32_t const r1a) // 0x3
     } while (!gtr);
 
     while (1) {
-        v5 += (r0 >= (uint32_t)r2) + v5;
-        if (r0 >= (uint32_t)r2)
+        v5 += ((uint32_t)r0 >= (uint32_t)r2) + v5;
+        if ((uint32_t)r0 >= (uint32_t)r2)
             r0 -= r2;
         if (r2 == r1)
             break;
         r2 = (uint32_t)r2 >> 1;
     }
 
-    if (!(r12 << 1))
+    if ((r12 << 1) == 0)
         return -v5;
     else
         return v5;
@@ -1488,7 +1622,7 @@ void BIOS_SndDriverMain() // 0x1dc4 -> 0x08004024 phantasy star
 
     //0x1ea2
     uint32_t r4 = puser1; // apparenty ch ptr?
-    int r9 = CPUReadMemory(r4 + 0x14);
+    uint32_t r9 = CPUReadMemory(r4 + 0x14);
     int r12 = CPUReadMemory(r4 + 0x18);
     uint32_t i = CPUReadByte(r4 + 0x6);
 
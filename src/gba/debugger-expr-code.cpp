@@ -0,0 +1,336 @@
+// Compiles debugger expressions once into a small stack program, so that
+// conditional breaks don't go back through the parser every time they are
+// tested. The language is the one of debugger-expr.y: the same lexer is
+// used, and operator precedence follows the %left declarations there
+// (+ - lowest, then * /, << >>, |, &, ^ highest, unary - and ~ binding
+// like + -). Registers and variables are resolved to pointers and ELF
+// symbols to constants when compiling.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../System.h"
+#include "../common/Port.h"
+#include "GBA.h"
+#include "debugger-expr-yacc.hpp"
+#include "elf.h"
+#include "remote.h"
+
+extern YYSTYPE dexp_lval;
+extern int dexp_lex();
+extern void dexp_flush();
+extern char* dexprString;
+extern int dexprCol;
+extern std::map<std::string, uint32_t> dexp_vars;
+
+#define DEXP_MAX_STACK 32
+
+enum {
+    DEXP_CONST,
+    DEXP_LOAD,
+    DEXP_NEG,
+    DEXP_NOT,
+    DEXP_READ8,
+    DEXP_READ16,
+    DEXP_READ32,
+    DEXP_ADD,
+    DEXP_SUB,
+    DEXP_MUL,
+    DEXP_DIV,
+    DEXP_SHL,
+    DEXP_SHR,
+    DEXP_OR,
+    DEXP_AND,
+    DEXP_XOR
+};
+
+struct dexp_op {
+    uint8_t op;
+    uint32_t value;
+    const uint32_t* ptr;
+};
+
+struct dexp_code {
+    std::vector<dexp_op> ops;
+};
+
+struct dexp_compiler {
+    dexp_code* code;
+    int token;
+    int depth;
+    bool error;
+};
+
+static void dexp_next(dexp_compiler* c)
+{
+    c->token = dexp_lex();
+}
+
+// precedence of a binary operator token, 0 if it isn't one
+static int dexp_precedence(int token)
+{
+    switch (token) {
+    case TOK_PLUS:
+    case TOK_MINUS:
+        return 1;
+    case TOK_MULTIPLY:
+    case TOK_DIVIDE:
+        return 2;
+    case TOK_LSHIFT:
+    case TOK_RSHIFT:
+        return 3;
+    case TOK_OR:
+        return 4;
+    case TOK_AND:
+        return 5;
+    case TOK_XOR:
+        return 6;
+    }
+    return 0;
+}
+
+static uint32_t dexp_apply(uint8_t op, uint32_t a, uint32_t b)
+{
+    switch (op) {
+    case DEXP_ADD:
+        return a + b;
+    case DEXP_SUB:
+        return a - b;
+    case DEXP_MUL:
+        return a * b;
+    case DEXP_DIV:
+        return b ? a / b : 0;
+    case DEXP_SHL:
+        return a << b;
+    case DEXP_SHR:
+        return a >> b;
+    case DEXP_OR:
+        return a | b;
+    case DEXP_AND:
+        return a & b;
+    default:
+        return a ^ b;
+    }
+}
+
+static void dexp_push(dexp_compiler* c, uint8_t op, uint32_t value, const uint32_t* ptr)
+{
+    dexp_op o = { op, value, ptr };
+    c->code->ops.push_back(o);
+    if (++c->depth > DEXP_MAX_STACK)
+        c->error = true;
+}
+
+// unary operators; folds them into constants where possible
+static void dexp_unary(dexp_compiler* c, uint8_t op)
+{
+    dexp_op& top = c->code->ops.back();
+    if (top.op == DEXP_CONST)
+        top.value = op == DEXP_NEG ? -top.value : ~top.value;
+    else {
+        dexp_op o = { op, 0, NULL };
+        c->code->ops.push_back(o);
+    }
+}
+
+static void dexp_binary(dexp_compiler* c, uint8_t op)
+{
+    std::vector<dexp_op>& ops = c->code->ops;
+    size_t n = ops.size();
+    if (ops[n - 2].op == DEXP_CONST && ops[n - 1].op == DEXP_CONST) {
+        ops[n - 2].value = dexp_apply(op, ops[n - 2].value, ops[n - 1].value);
+        ops.pop_back();
+    } else {
+        dexp_op o = { op, 0, NULL };
+        ops.push_back(o);
+    }
+    c->depth--;
+}
+
+static void dexp_expression(dexp_compiler* c, int minPrecedence);
+
+static void dexp_primary(dexp_compiler* c)
+{
+    int token = c->token;
+    uint8_t op;
+    switch (token) {
+    case TOK_NUMBER:
+        dexp_push(c, DEXP_CONST, dexp_lval.number, NULL);
+        dexp_next(c);
+        return;
+    case TOK_REGISTER:
+        dexp_push(c, DEXP_LOAD, 0, &reg[dexp_lval.number].I);
+        dexp_next(c);
+        return;
+    case TOK_ID: {
+        std::string name(dexp_lval.string);
+        std::map<std::string, uint32_t>::iterator var = dexp_vars.find(name);
+        uint32_t addr, size;
+        int type;
+        if (var != dexp_vars.end())
+            dexp_push(c, DEXP_LOAD, 0, &var->second);
+        else if (elfGetSymbolAddress(name.c_str(), &addr, &size, &type))
+            dexp_push(c, DEXP_CONST, addr, NULL);
+        else {
+            printf("Variable %s not defined.\n", name.c_str());
+            c->error = true;
+            return;
+        }
+        dexp_next(c);
+        return;
+    }
+    case TOK_MINUS:
+    case TOK_NEGATE:
+        dexp_next(c);
+        dexp_primary(c);
+        dexp_expression(c, 2);
+        if (!c->error)
+            dexp_unary(c, token == TOK_MINUS ? DEXP_NEG : DEXP_NOT);
+        return;
+    case TOK_LPAREN:
+        dexp_next(c);
+        dexp_primary(c);
+        dexp_expression(c, 1);
+        if (c->token != TOK_RPAREN)
+            c->error = true;
+        dexp_next(c);
+        return;
+    case TOK_BBRACKET:
+        op = DEXP_READ8;
+        break;
+    case TOK_HBRACKET:
+        op = DEXP_READ16;
+        break;
+    case TOK_WBRACKET:
+    case TOK_LBRACKET:
+        op = DEXP_READ32;
+        break;
+    default:
+        c->error = true;
+        return;
+    }
+    dexp_next(c);
+    dexp_primary(c);
+    dexp_expression(c, 1);
+    if (c->token != TOK_RBRACKET)
+        c->error = true;
+    if (!c->error) {
+        dexp_op o = { op, 0, NULL };
+        c->code->ops.push_back(o);
+    }
+    dexp_next(c);
+}
+
+// the left operand is already on the stack
+static void dexp_expression(dexp_compiler* c, int minPrecedence)
+{
+    int precedence;
+    while (!c->error && (precedence = dexp_precedence(c->token)) >= minPrecedence) {
+        int token = c->token;
+        dexp_next(c);
+        dexp_primary(c);
+        // all operators are left associative
+        while (!c->error && dexp_precedence(c->token) > precedence)
+            dexp_expression(c, precedence + 1);
+        if (c->error)
+            return;
+        switch (token) {
+        case TOK_PLUS:
+            dexp_binary(c, DEXP_ADD);
+            break;
+        case TOK_MINUS:
+            dexp_binary(c, DEXP_SUB);
+            break;
+        case TOK_MULTIPLY:
+            dexp_binary(c, DEXP_MUL);
+            break;
+        case TOK_DIVIDE:
+            dexp_binary(c, DEXP_DIV);
+            break;
+        case TOK_LSHIFT:
+            dexp_binary(c, DEXP_SHL);
+            break;
+        case TOK_RSHIFT:
+            dexp_binary(c, DEXP_SHR);
+            break;
+        case TOK_OR:
+            dexp_binary(c, DEXP_OR);
+            break;
+        case TOK_AND:
+            dexp_binary(c, DEXP_AND);
+            break;
+        default:
+            dexp_binary(c, DEXP_XOR);
+            break;
+        }
+    }
+}
+
+struct dexp_code* dexp_compile(char* expr)
+{
+    dexp_flush();
+    dexprString = expr;
+    dexprCol = 0;
+
+    dexp_compiler c;
+    c.code = new dexp_code;
+    c.depth = 0;
+    c.error = false;
+    dexp_next(&c);
+    dexp_primary(&c);
+    dexp_expression(&c, 1);
+
+    if (c.error || c.token != 0) {
+        delete c.code;
+        return NULL;
+    }
+    return c.code;
+}
+
+void dexp_free(struct dexp_code* code)
+{
+    delete code;
+}
+
+uint32_t dexp_run(const struct dexp_code* code)
+{
+    uint32_t stack[DEXP_MAX_STACK];
+    int sp = -1;
+    const dexp_op* op = &code->ops[0];
+    const dexp_op* end = op + code->ops.size();
+
+    for (; op != end; op++) {
+        switch (op->op) {
+        case DEXP_CONST:
+            stack[++sp] = op->value;
+            break;
+        case DEXP_LOAD:
+            stack[++sp] = *op->ptr;
+            break;
+        case DEXP_NEG:
+            stack[sp] = -stack[sp];
+            break;
+        case DEXP_NOT:
+            stack[sp] = ~stack[sp];
+            break;
+        case DEXP_READ8:
+            stack[sp] = map[stack[sp] >> 24].address[stack[sp] & map[stack[sp] >> 24].mask];
+            break;
+        case DEXP_READ16:
+            stack[sp] = READ16LE((&map[stack[sp] >> 24].address[stack[sp] & map[stack[sp] >> 24].mask]));
+            break;
+        case DEXP_READ32:
+            stack[sp] = READ32LE((&map[stack[sp] >> 24].address[stack[sp] & map[stack[sp] >> 24].mask]));
+            break;
+        default:
+            sp--;
+            stack[sp] = dexp_apply(op->op, stack[sp], stack[sp + 1]);
+            break;
+        }
+    }
+    return stack[0];
+}
@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "../NLS.h"
 #include "../common/Port.h"
 #include "GBA.h"
@@ -239,28 +242,131 @@ CompileUnit* elfCurrentUnit = NULL;
 uint32_t elfRead4Bytes(uint8_t*);
 uint16_t elfRead2Bytes(uint8_t*);
 
-CompileUnit* elfGetCompileUnit(uint32_t addr)
+// Address ranges of compile units, functions, symbols and FDEs, sorted by
+// start so lookups are a binary search. maxHigh[i] is the highest end
+// among the first i+1 ranges, which bounds the walk back over ranges that
+// start before the address. Where ranges overlap, the one that came first
+// in the ELF file wins, as it did with the linear searches.
+struct ELFRange {
+    uint32_t low;
+    uint32_t high;
+    int order;
+    void* item;
+    CompileUnit* unit;
+};
+
+struct ELFRangeIndex {
+    std::vector<ELFRange> ranges;
+    std::vector<uint32_t> maxHigh;
+};
+
+static ELFRangeIndex elfUnitIndex;
+static ELFRangeIndex elfFunctionIndex;
+static ELFRangeIndex elfSymbolIndex;
+static ELFRangeIndex elfFdeIndex;
+
+static void elfAddRange(ELFRangeIndex& index, uint32_t low, uint32_t high, void* item, CompileUnit* unit)
 {
-    if (elfCompileUnits) {
-        CompileUnit* unit = elfCompileUnits;
-        while (unit) {
-            if (unit->lowPC) {
-                if (addr >= unit->lowPC && addr < unit->highPC)
-                    return unit;
-            } else {
-                ARanges* r = unit->ranges;
-                if (r) {
-                    int count = r->count;
-                    for (int j = 0; j < count; j++) {
-                        if (addr >= r->ranges[j].lowPC && addr < r->ranges[j].highPC)
-                            return unit;
-                    }
-                }
-            }
-            unit = unit->next;
-        }
+    if (low < high) {
+        ELFRange r = { low, high, (int)index.ranges.size(), item, unit };
+        index.ranges.push_back(r);
     }
-    return NULL;
+}
+
+static bool elfRangeLess(const ELFRange& a, const ELFRange& b)
+{
+    return a.low < b.low;
+}
+
+static bool elfRangeStartsAfter(uint32_t addr, const ELFRange& r)
+{
+    return addr < r.low;
+}
+
+static void elfSortRanges(ELFRangeIndex& index)
+{
+    std::sort(index.ranges.begin(), index.ranges.end(), elfRangeLess);
+    index.maxHigh.resize(index.ranges.size());
+    uint32_t high = 0;
+    for (size_t i = 0; i < index.ranges.size(); i++) {
+        high = std::max(high, index.ranges[i].high);
+        index.maxHigh[i] = high;
+    }
+}
+
+static void elfClearRanges(ELFRangeIndex& index)
+{
+    index.ranges.clear();
+    index.maxHigh.clear();
+}
+
+// first range holding addr, only looking at those of unit if one is given
+static const ELFRange* elfFindRange(const ELFRangeIndex& index, uint32_t addr, CompileUnit* unit = NULL)
+{
+    const ELFRange* found = NULL;
+    size_t i = std::upper_bound(index.ranges.begin(), index.ranges.end(), addr, elfRangeStartsAfter) - index.ranges.begin();
+    while (i > 0 && index.maxHigh[i - 1] > addr) {
+        const ELFRange* r = &index.ranges[--i];
+        if (addr < r->high && (!unit || r->unit == unit) && (!found || r->order < found->order))
+            found = r;
+    }
+    return found;
+}
+
+static void elfIndexLines(LineInfo* l)
+{
+    std::vector<std::pair<uint32_t, int> > byAddress(l->number);
+    for (int i = 0; i < l->number; i++)
+        byAddress[i] = std::make_pair(l->lines[i].address, i);
+    std::sort(byAddress.begin(), byAddress.end());
+
+    l->sortedAddresses = (uint32_t*)malloc(l->number * sizeof(uint32_t));
+    l->firstLine = (int*)malloc(l->number * sizeof(int));
+    int first = l->number;
+    for (int i = l->number - 1; i >= 0; i--) {
+        first = std::min(first, byAddress[i].second);
+        l->sortedAddresses[i] = byAddress[i].first;
+        l->firstLine[i] = first;
+    }
+}
+
+static void elfBuildIndex()
+{
+    for (CompileUnit* unit = elfCompileUnits; unit; unit = unit->next) {
+        if (unit->lowPC)
+            elfAddRange(elfUnitIndex, unit->lowPC, unit->highPC, unit, unit);
+        else if (unit->ranges) {
+            ARanges* r = unit->ranges;
+            for (int j = 0; j < r->count; j++)
+                elfAddRange(elfUnitIndex, r->ranges[j].lowPC, r->ranges[j].highPC, unit, unit);
+        }
+        for (Function* func = unit->functions; func; func = func->next)
+            elfAddRange(elfFunctionIndex, func->lowPC, func->highPC, func, unit);
+        if (unit->hasLineInfo && unit->lineInfoTable->number)
+            elfIndexLines(unit->lineInfoTable);
+    }
+    for (int i = 0; i < elfSymbolsCount; i++) {
+        Symbol* s = &elfSymbols[i];
+        uint32_t high = s->value + s->size;
+        // a symbol also matches its own address when it has no size
+        if (high <= s->value)
+            high = s->value + 1;
+        if (high > s->value)
+            elfAddRange(elfSymbolIndex, s->value, high, s, NULL);
+    }
+    for (int i = 0; i < elfFdeCount; i++)
+        elfAddRange(elfFdeIndex, elfFdes[i]->address, elfFdes[i]->end, elfFdes[i], NULL);
+
+    elfSortRanges(elfUnitIndex);
+    elfSortRanges(elfFunctionIndex);
+    elfSortRanges(elfSymbolIndex);
+    elfSortRanges(elfFdeIndex);
+}
+
+CompileUnit* elfGetCompileUnit(uint32_t addr)
+{
+    const ELFRange* r = elfFindRange(elfUnitIndex, addr);
+    return r ? r->unit : NULL;
 }
 
 const char* elfGetAddressSymbol(uint32_t addr)
@@ -270,49 +376,37 @@ const char* elfGetAddressSymbol(uint32_t addr)
     CompileUnit* unit = elfGetCompileUnit(addr);
     // found unit, need to find function
     if (unit) {
-        Function* func = unit->functions;
-        while (func) {
-            if (addr >= func->lowPC && addr < func->highPC) {
-                int offset = addr - func->lowPC;
-                const char* name = func->name;
-                if (!name)
-                    name = "";
-                if (offset)
-                    snprintf(buffer, 256, "%s+%d", name, offset);
-                else {
-                    strncpy(buffer, name, 255);		//strncpy does not allways append a '\0'
-		    buffer[255] = '\0';
-		}
-                return buffer;
+        const ELFRange* r = elfFindRange(elfFunctionIndex, addr, unit);
+        if (r) {
+            Function* func = (Function*)r->item;
+            int offset = addr - func->lowPC;
+            const char* name = func->name;
+            if (!name)
+                name = "";
+            if (offset)
+                snprintf(buffer, 256, "%s+%d", name, offset);
+            else {
+                strncpy(buffer, name, 255);		//strncpy does not allways append a '\0'
+                buffer[255] = '\0';
             }
-            func = func->next;
+            return buffer;
         }
     }
 
-    if (elfSymbolsCount) {
-        for (int i = 0; i < elfSymbolsCount; i++) {
-            Symbol* s = &elfSymbols[i];
-            if ((addr >= s->value) && addr < (s->value + s->size)) {
-                int offset = addr - s->value;
-                const char* name = s->name;
-                if (name == NULL)
-                    name = "";
-                if (offset)
-                    snprintf(buffer, 256,"%s+%d", name, addr - s->value);
-                else {
-                    strncpy(buffer, name, 255);
-		    buffer[255] = '\0';
-		}
-                return buffer;
-            } else if (addr == s->value) {
-                if (s->name) {
-                    strncpy(buffer, s->name, 255);
-		    buffer[255] = '\0';
-		} else
-                    strcpy(buffer, "");
-                return buffer;
-            }
+    const ELFRange* r = elfFindRange(elfSymbolIndex, addr);
+    if (r) {
+        Symbol* s = (Symbol*)r->item;
+        int offset = addr - s->value;
+        const char* name = s->name;
+        if (name == NULL)
+            name = "";
+        if (offset)
+            snprintf(buffer, 256, "%s+%d", name, offset);
+        else {
+            strncpy(buffer, name, 255);
+            buffer[255] = '\0';
         }
+        return buffer;
     }
     return "";
 }
@@ -354,16 +448,12 @@ bool elfFindLineInModule(uint32_t* addr, const char* name, int line)
 int elfFindLine(CompileUnit* unit, Function* /* func */, uint32_t addr, const char** f)
 {
     int currentLine = -1;
-    if (unit->hasLineInfo) {
-        int count = unit->lineInfoTable->number;
-        LineInfoItem* table = unit->lineInfoTable->lines;
-        int i;
-        for (i = 0; i < count; i++) {
-            if (addr <= table[i].address)
-                break;
-        }
-        if (i == count)
-            i--;
+    if (unit->hasLineInfo && unit->lineInfoTable->number) {
+        LineInfo* l = unit->lineInfoTable;
+        // the first line at or after addr, or the last one
+        int i = std::lower_bound(l->sortedAddresses, l->sortedAddresses + l->number, addr) - l->sortedAddresses;
+        i = i < l->number ? l->firstLine[i] : l->number - 1;
+        LineInfoItem* table = l->lines;
         *f = table[i].file;
         currentLine = table[i].line;
     }
@@ -391,14 +481,11 @@ bool elfGetCurrentFunction(uint32_t addr, Function** f, CompileUnit** u)
     CompileUnit* unit = elfGetCompileUnit(addr);
     // found unit, need to find function
     if (unit) {
-        Function* func = unit->functions;
-        while (func) {
-            if (addr >= func->lowPC && addr < func->highPC) {
-                *f = func;
-                *u = unit;
-                return true;
-            }
-            func = func->next;
+        const ELFRange* r = elfFindRange(elfFunctionIndex, addr, unit);
+        if (r) {
+            *f = (Function*)r->item;
+            *u = unit;
+            return true;
         }
     }
     return false;
@@ -483,16 +570,8 @@ bool elfGetSymbolAddress(const char* sym, uint32_t* addr, uint32_t* size, int* t
 
 ELFfde* elfGetFde(uint32_t address)
 {
-    if (elfFdes) {
-        int i;
-        for (i = 0; i < elfFdeCount; i++) {
-            if (address >= elfFdes[i]->address && address < elfFdes[i]->end) {
-                return elfFdes[i];
-            }
-        }
-    }
-
-    return NULL;
+    const ELFRange* r = elfFindRange(elfFdeIndex, address);
+    return r ? (ELFfde*)r->item : NULL;
 }
 
 void elfExecuteCFAInstructions(ELFFrameState* state, uint8_t* data, uint32_t len,
@@ -2701,6 +2780,7 @@ bool elfReadProgram(ELFHeader* eh, uint8_t* data, unsigned long data_size, int&
         }
         elfParseCFA(data);
         elfReadSymtab(data);
+        elfBuildIndex();
     }
 end:
     if (sh) {
@@ -2860,6 +2940,8 @@ void elfCleanUp(CompileUnit* comp)
         o = next;
     }
     if (comp->lineInfoTable) {
+        free(comp->lineInfoTable->sortedAddresses);
+        free(comp->lineInfoTable->firstLine);
         free(comp->lineInfoTable->lines);
         free(comp->lineInfoTable->files);
         free(comp->lineInfoTable);
@@ -2868,6 +2950,11 @@ void elfCleanUp(CompileUnit* comp)
 
 void elfCleanUp()
 {
+    elfClearRanges(elfUnitIndex);
+    elfClearRanges(elfFunctionIndex);
+    elfClearRanges(elfSymbolIndex);
+    elfClearRanges(elfFdeIndex);
+
     CompileUnit* comp = elfCompileUnits;
 
     while (comp) {
@@ -194,6 +194,10 @@ struct LineInfo {
     char** files;
     int number;
     LineInfoItem* lines;
+    // line addresses in ascending order, and for each of them the lowest
+    // index into lines whose address is at or after it
+    uint32_t* sortedAddresses;
+    int* firstLine;
 };
 
 struct ARange {
@@ -5,6 +5,7 @@
 
 #include <iosfwd>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #ifndef _WIN32
@@ -47,6 +48,12 @@ SOCKET remoteSocket = -1;
 SOCKET remoteListenSocket = -1;
 bool remoteConnected = false;
 bool remoteResumed = false;
+// set by QStartNoAckMode: packets are no longer acknowledged either way
+static bool remoteNoAck = false;
+// reused for every outgoing packet
+static std::vector<char> remotePacket;
+// largest reply payload; qSupported advertises it as PacketSize
+#define REMOTE_PACKET_SIZE 0x1000
 
 int (*remoteSendFnc)(char*, int) = NULL;
 int (*remoteRecvFnc)(char*, int) = NULL;
@@ -56,6 +63,7 @@ void (*remoteCleanUpFnc)() = NULL;
 #ifndef SDL
 void remoteSetSockets(SOCKET l, SOCKET r)
 {
+    remoteNoAck = false;
     remoteSocket = r;
     remoteListenSocket = l;
 }
@@ -137,6 +145,9 @@ struct regBreak* getFromBreakRegList(uint8_t regnum, int location)
 }
 
 bool enableRegBreak = false;
+// set once a breakpoint flag is written to map[].breakPoints, so the CPU
+// loops know they have to look at them
+bool breakpointsActive = false;
 reg_pair oldReg[16];
 uint32_t regDiff[16];
 
@@ -756,155 +767,139 @@ void debuggerFillWord(int n, char** args)
 unsigned int SearchStart = 0xFFFFFFFF;
 unsigned int SearchMaxMatches = 5;
 uint8_t SearchData[64]; // It actually doesn't make much sense to search for more than 64 bytes, does it?
+uint8_t SearchMask[64]; // bits of SearchData that have to match
 unsigned int SearchLength = 0;
 unsigned int SearchResults;
 
-unsigned int AddressToGBA(uint8_t* mem)
-{
-    if (mem >= &bios[0] && mem <= &bios[0x3fff])
-        return 0x00000000 + (mem - &bios[0]);
-    else if (mem >= &workRAM[0] && mem <= &workRAM[0x3ffff])
-        return 0x02000000 + (mem - &workRAM[0]);
-    else if (mem >= &internalRAM[0] && mem <= &internalRAM[0x7fff])
-        return 0x03000000 + (mem - &internalRAM[0]);
-    else if (mem >= &ioMem[0] && mem <= &ioMem[0x3ff])
-        return 0x04000000 + (mem - &ioMem[0]);
-    else if (mem >= &paletteRAM[0] && mem <= &paletteRAM[0x3ff])
-        return 0x05000000 + (mem - &paletteRAM[0]);
-    else if (mem >= &vram[0] && mem <= &vram[0x1ffff])
-        return 0x06000000 + (mem - &vram[0]);
-    else if (mem >= &oam[0] && mem <= &oam[0x3ff])
-        return 0x07000000 + (mem - &oam[0]);
-    else if (mem >= &rom[0] && mem <= &rom[0x1ffffff])
-        return 0x08000000 + (mem - &rom[0]);
-    else
-        return 0xFFFFFFFF;
+// regions larger than this are split across threads
+#define SEARCH_THREAD_MIN 0x100000
+
+struct SearchRegion {
+    uint32_t address;
+    uint8_t** mem;
+    uint32_t size;
 };
 
+static const SearchRegion searchRegions[] = {
+    { 0x00000000, &bios, 0x4000 },
+    { 0x02000000, &workRAM, 0x40000 },
+    { 0x03000000, &internalRAM, 0x8000 },
+    { 0x04000000, &ioMem, 0x400 },
+    { 0x05000000, &paletteRAM, 0x400 },
+    { 0x06000000, &vram, 0x20000 },
+    { 0x07000000, &oam, 0x400 },
+    { 0x08000000, &rom, 0x2000000 }
+};
+
+static bool debuggerSearchMatch(const uint8_t* mem)
+{
+    for (unsigned int i = 0; i < SearchLength; i++)
+        if ((mem[i] & SearchMask[i]) != SearchData[i])
+            return false;
+    return true;
+}
+
+// Collects the offsets in [from, to) where the search data starts, at most
+// max of them unless max is 0. memchr looks for the first byte that is not
+// a wildcard, and only where it is found is the rest compared.
+static void debuggerSearchBlock(const uint8_t* mem, uint32_t from, uint32_t to, unsigned int max, std::vector<uint32_t>* hits)
+{
+    unsigned int anchor = 0;
+    while (anchor < SearchLength && SearchMask[anchor] != 0xff)
+        anchor++;
+
+    bool exact = true;
+    for (unsigned int i = 0; exact && i < SearchLength; i++)
+        exact = SearchMask[i] == 0xff;
+
+    for (uint32_t offset = from; offset < to; offset++) {
+        if (anchor < SearchLength) {
+            const uint8_t* p = (const uint8_t*)memchr(mem + offset + anchor, SearchData[anchor], to - offset);
+            if (!p)
+                return;
+            offset = (uint32_t)(p - mem) - anchor;
+        }
+
+        if (exact ? !memcmp(mem + offset, SearchData, SearchLength) : debuggerSearchMatch(mem + offset)) {
+            hits->push_back(offset);
+            if (hits->size() == max)
+                return;
+        }
+    }
+}
+
+static void debuggerSearchRegion(const uint8_t* mem, uint32_t from, uint32_t to, unsigned int max, std::vector<uint32_t>& hits)
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+
+    if (to - from < SEARCH_THREAD_MIN || threads < 2) {
+        debuggerSearchBlock(mem, from, to, max, &hits);
+        return;
+    }
+
+    // each thread finds the first hits of its share; the first max of
+    // them all, in address order, are the result
+    std::vector<std::vector<uint32_t> > found(threads);
+    std::vector<std::thread> workers;
+    uint32_t share = (to - from + threads - 1) / threads;
+
+    for (unsigned int i = 0; i < threads; i++) {
+        uint32_t begin = from + i * share;
+        uint32_t end = begin + share < to ? begin + share : to;
+        if (begin < end)
+            workers.push_back(std::thread(debuggerSearchBlock, mem, begin, end, max, &found[i]));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    for (unsigned int i = 0; i < threads; i++) {
+        for (size_t j = 0; j < found[i].size(); j++) {
+            if (max && hits.size() == max)
+                return;
+            hits.push_back(found[i][j]);
+        }
+    }
+}
+
 void debuggerDoSearch()
 {
     unsigned int count = 0;
+    std::vector<uint32_t> hits;
 
-    while (true) {
-        unsigned int final = SearchStart + SearchLength - 1;
-        uint8_t* end;
-        uint8_t* start;
+    for (size_t r = 0; r < sizeof(searchRegions) / sizeof(searchRegions[0]); r++) {
+        const SearchRegion& region = searchRegions[r];
 
-        switch (SearchStart >> 24) {
-        case 0:
-            if (final > 0x00003FFF) {
-                SearchStart = 0x02000000;
-                continue;
-            } else {
-                start = bios + (SearchStart & 0x3FFF);
-                end = bios + 0x3FFF;
-                break;
-            };
-        case 2:
-            if (final > 0x0203FFFF) {
-                SearchStart = 0x03000000;
-                continue;
-            } else {
-                start = workRAM + (SearchStart & 0x3FFFF);
-                end = workRAM + 0x3FFFF;
-                break;
-            };
-        case 3:
-            if (final > 0x03007FFF) {
-                SearchStart = 0x04000000;
-                continue;
-            } else {
-                start = internalRAM + (SearchStart & 0x7FFF);
-                end = internalRAM + 0x7FFF;
-                break;
-            };
-        case 4:
-            if (final > 0x040003FF) {
-                SearchStart = 0x05000000;
-                continue;
-            } else {
-                start = ioMem + (SearchStart & 0x3FF);
-                end = ioMem + 0x3FF;
-                break;
-            };
-        case 5:
-            if (final > 0x050003FF) {
-                SearchStart = 0x06000000;
-                continue;
-            } else {
-                start = paletteRAM + (SearchStart & 0x3FF);
-                end = paletteRAM + 0x3FF;
-                break;
-            };
-        case 6:
-            if (final > 0x0601FFFF) {
-                SearchStart = 0x07000000;
-                continue;
-            } else {
-                start = vram + (SearchStart & 0x1FFFF);
-                end = vram + 0x1FFFF;
-                break;
-            };
-        case 7:
-            if (final > 0x070003FF) {
-                SearchStart = 0x08000000;
-                continue;
-            } else {
-                start = oam + (SearchStart & 0x3FF);
-                end = oam + 0x3FF;
-                break;
-            };
-        case 8:
-        case 9:
-        case 10:
-        case 11:
-        case 12:
-        case 13:
-            if (final <= 0x09FFFFFF) {
-                start = rom + (SearchStart & 0x01FFFFFF);
-                end = rom + 0x01FFFFFF;
-                break;
-            };
-        default: {
-            sprintf(monbuf, "Search completed.\n");
-            monprintf(monbuf);
-        }
-            SearchLength = 0;
-            return;
-        };
+        if (!*region.mem || SearchLength > region.size || SearchStart >= region.address + region.size)
+            continue;
 
-        end -= SearchLength - 1;
-        uint8_t firstbyte = SearchData[0];
-        while (start <= end) {
-            while ((start <= end) && (*start != firstbyte))
-                start++;
+        uint32_t from = SearchStart > region.address ? SearchStart - region.address : 0;
+        uint32_t to = region.size - SearchLength + 1;
 
-            if (start > end)
-                break;
+        if (from >= to)
+            continue;
 
-            unsigned int p = 1;
-            while ((start[p] == SearchData[p]) && (p < SearchLength))
-                p++;
+        hits.clear();
+        debuggerSearchRegion(*region.mem, from, to, SearchMaxMatches ? SearchMaxMatches - count : 0, hits);
 
-            if (p == SearchLength) {
-                {
-                    sprintf(monbuf, "Search result (%d): %08x\n", count + SearchResults, AddressToGBA(start));
-                    monprintf(monbuf);
-                }
-                count++;
-                if (count == SearchMaxMatches) {
-                    SearchStart = AddressToGBA(start + p);
-                    SearchResults += count;
-                    return;
-                };
+        for (size_t i = 0; i < hits.size(); i++) {
+            sprintf(monbuf, "Search result (%d): %08x\n", count + SearchResults, region.address + hits[i]);
+            monprintf(monbuf);
+            count++;
+        }
 
-                start += p; // assume areas don't overlap; alternative: start++;
-            } else
-                start++;
-        };
+        if (SearchMaxMatches && count == SearchMaxMatches) {
+            SearchStart = region.address + hits.back() + 1;
+            SearchResults += count;
+            return;
+        }
+    }
 
-        SearchStart = AddressToGBA(end + SearchLength - 1) + 1;
-    };
+    {
+        sprintf(monbuf, "Search completed.\n");
+        monprintf(monbuf);
+    }
+    SearchLength = 0;
 };
 
 void debuggerFindText(int n, char** args)
@@ -936,12 +931,30 @@ void debuggerFindText(int n, char** args)
             SearchLength = 64;
         };
 
+        memset(SearchMask, 0xff, sizeof(SearchMask));
         debuggerDoSearch();
 
     } else
         debuggerUsage("ft");
 };
 
+// a hex digit, or ? for any value
+static bool debuggerHexNibble(char c, uint8_t* value, uint8_t* mask)
+{
+    *mask = 0xf;
+    if (c >= '0' && c <= '9')
+        *value = c - '0';
+    else if (c >= 'a' && c <= 'f')
+        *value = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+        *value = c - 'A' + 10;
+    else if (c == '?')
+        *value = *mask = 0;
+    else
+        return false;
+    return true;
+}
+
 void debuggerFindHex(int n, char** args)
 {
     if ((n == 4) || (n == 3)) {
@@ -980,9 +993,17 @@ void debuggerFindHex(int n, char** args)
         };
 
         for (unsigned int i = 0; i < SearchLength; i++) {
-            unsigned int cbuf = 0;
-            sscanf(&SearchHex[i << 1], "%02x", &cbuf);
-            SearchData[i] = cbuf;
+            uint8_t hi, lo, himask, lomask;
+            if (!debuggerHexNibble(SearchHex[i << 1], &hi, &himask) || !debuggerHexNibble(SearchHex[(i << 1) + 1], &lo, &lomask)) {
+                {
+                    sprintf(monbuf, "Invalid hex-string.\n");
+                    monprintf(monbuf);
+                }
+                SearchLength = 0;
+                return;
+            }
+            SearchData[i] = (hi << 4) | lo;
+            SearchMask[i] = (himask << 4) | lomask;
         };
 
         debuggerDoSearch();
@@ -3051,8 +3072,8 @@ DebuggerCommand debuggerCommands[] = {
     { "copyh", debuggerCopyHalfWord, "Copies memory content (half-word)", "{address} {second address} {size} optional{repeat}" },
     { "copyw", debuggerCopyWord, "Copies memory content (word)", "{address} {second address} {size} optional{repeat}" },
 
-    { "ft", debuggerFindText, "Search memory for ASCII-string.", "<start> [<max-result>] <string>" },
-    { "fh", debuggerFindHex, "Search memory for hex-string.", "<start> [<max-result>] <hex-string>" },
+    { "ft", debuggerFindText, "Search memory for ASCII-string. A max-result of 0 lists all matches.", "<start> [<max-result>] <string>" },
+    { "fh", debuggerFindHex, "Search memory for hex-string. ? matches any digit. A max-result of 0 lists all matches.", "<start> [<max-result>] <hex-string>" },
     { "fr", debuggerFindResume, "Resume current search.", "[<max-result>]" },
 
     { "io", debuggerIo, "Show I/O registers status", "[video|video2|dma|timer|misc]" },
@@ -3530,44 +3551,59 @@ void remoteSetProtocol(int p)
 
 void remoteInit()
 {
+    remoteNoAck = false;
     if (remoteInitFnc)
         remoteInitFnc();
 }
 
-void remotePutPacket(const char* packet)
+// binary-safe: '#', '$', '}' and '*' in the payload are escaped
+void remotePutPacket(const char* packet, size_t count)
 {
     const char* hex = "0123456789abcdef";
 
-    size_t count = strlen(packet);
-    char* buffer = new char[count + 5];
+    remotePacket.resize(count * 2 + 5);
 
     unsigned char csum = 0;
 
+    char* buffer = &remotePacket[0];
     char* p = buffer;
     *p++ = '$';
 
     for (size_t i = 0; i < count; i++) {
-        csum += packet[i];
-        *p++ = packet[i];
+        char c = packet[i];
+        if (c == '#' || c == '$' || c == '}' || c == '*') {
+            csum += 0x7d;
+            *p++ = 0x7d;
+            c ^= 0x20;
+        }
+        csum += c;
+        *p++ = c;
     }
     *p++ = '#';
     *p++ = hex[csum >> 4];
     *p++ = hex[csum & 15];
-    *p++ = 0;
+    *p = 0;
     //log("send: %s\n", buffer);
 
+    int len = (int)(p - buffer);
+    if (remoteNoAck) {
+        remoteSendFnc(buffer, len);
+        return;
+    }
+
     char c = 0;
     while (c != '+') {
-        remoteSendFnc(buffer, (int)count + 4);
+        remoteSendFnc(buffer, len);
 
-        if (remoteRecvFnc(&c, 1) < 0) {
-            delete[] buffer;
+        if (remoteRecvFnc(&c, 1) < 0)
             return;
-        }
         //    fprintf(stderr,"sent:%s recieved:%c\n",buffer,c);
     }
+}
 
-    delete[] buffer;
+void remotePutPacket(const char* packet)
+{
+    remotePutPacket(packet, strlen(packet));
 }
 
 void remoteOutput(const char* s, uint32_t addr)
@@ -3693,26 +3729,75 @@ void remoteMemoryWrite(char* p)
     remotePutPacket("OK");
 }
 
+// copy count bytes at address out of map[], a region at a time;
+// unmapped regions read as 0
+static void remoteReadBlock(uint32_t address, uint32_t count, uint8_t* dest)
+{
+    while (count) {
+        memoryMap* m = &map[address >> 24];
+        uint32_t offset = address & m->mask;
+        // stop at the end of the region or where its mirror wraps
+        uint32_t run = m->mask - offset + 1;
+        if (run > 0x1000000 - (address & 0xffffff))
+            run = 0x1000000 - (address & 0xffffff);
+        if (run > count)
+            run = count;
+
+        if (m->address)
+            memcpy(dest, &m->address[offset], run);
+        else
+            memset(dest, 0, run);
+
+        address += run;
+        dest += run;
+        count -= run;
+    }
+}
+
+static std::vector<uint8_t> remoteReadBuffer;
+
 void remoteMemoryRead(char* p)
 {
+    const char* hex = "0123456789abcdef";
     uint32_t address;
     int count;
     sscanf(p, "%x,%x:", &address, &count);
     //  monprintf("Memory read for %08x %d\n", address, count);
 
-    char* buffer = new char[(count*2)+1];
+    // gdb accepts a short read and asks for the rest
+    if (count < 0)
+        count = 0;
+    else if (count > REMOTE_PACKET_SIZE / 2)
+        count = REMOTE_PACKET_SIZE / 2;
 
-    char* s = buffer;
+    remoteReadBuffer.resize(count * 3 + 1);
+    uint8_t* data = &remoteReadBuffer[count * 2];
+    remoteReadBlock(address, count, data);
+
+    char* s = (char*)&remoteReadBuffer[0];
     for (int i = 0; i < count; i++) {
-        uint8_t b = debuggerReadByte(address);
-        sprintf(s, "%02x", b);
-        address++;
-        s += 2;
+        *s++ = hex[data[i] >> 4];
+        *s++ = hex[data[i] & 15];
     }
-    *s = 0;
-    remotePutPacket(buffer);
+    remotePutPacket((char*)&remoteReadBuffer[0], count * 2);
+}
+
+// 'x': like 'm', but the reply is 'b' followed by the raw bytes
+void remoteBinaryRead(char* p)
+{
+    uint32_t address;
+    int count;
+    sscanf(p, "%x,%x:", &address, &count);
+
+    if (count < 0)
+        count = 0;
+    else if (count > REMOTE_PACKET_SIZE - 1)
+        count = REMOTE_PACKET_SIZE - 1;
 
-    delete[] buffer;
+    remoteReadBuffer.resize(count + 1);
+    remoteReadBuffer[0] = 'b';
+    remoteReadBlock(address, count, &remoteReadBuffer[1]);
+    remotePutPacket((char*)&remoteReadBuffer[0], count + 1);
 }
 
 void remoteQuery(char* p)
@@ -3722,7 +3807,7 @@ void remoteQuery(char* p)
     } else if (!strncmp(p, "sThreadInfo", 11)) {
         remotePutPacket("l");
     } else if (!strncmp(p, "Supported", 9)) {
-        remotePutPacket("PacketSize=1000");
+        remotePutPacket("PacketSize=1000;QStartNoAckMode+;binary-upload+;vContSupported+");
     } else if (!strncmp(p, "HostInfo", 8)) {
         remotePutPacket("cputype:12;cpusubtype:5;ostype:unknown;vendor:nintendo;endian:little;ptrsize:4;");
     } else if (!strncmp(p, "C", 1)) {
@@ -3742,6 +3827,57 @@ void remoteQuery(char* p)
     }
 }
 
+void remoteSet(char* p)
+{
+    if (!strncmp(p, "StartNoAckMode", 14)) {
+        // the reply still gets acknowledged
+        remotePutPacket("OK");
+        remoteNoAck = true;
+    } else {
+        fprintf(stderr, "Unknown packet %s\n", --p);
+        remotePutPacket("");
+    }
+}
+
+void remoteStep()
+{
+    remoteResumed = true;
+    remoteSignal = 5;
+    CPULoop(1);
+    if (remoteResumed) {
+        remoteResumed = false;
+        remoteSendStatus();
+    }
+}
+
+// vCont; there is one thread, so only the first action matters.
+// returns true if execution resumes
+bool remoteVerbose(char* p)
+{
+    if (!strncmp(p, "Cont?", 5)) {
+        remotePutPacket("vCont;c;C;s;S");
+    } else if (!strncmp(p, "Cont;", 5)) {
+        switch (p[5]) {
+        case 'c':
+        case 'C':
+            remoteResumed = true;
+            debugger = false;
+            return true;
+        case 's':
+        case 'S':
+            remoteStep();
+            break;
+        default:
+            remotePutPacket("E01");
+            break;
+        }
+    } else {
+        // includes vMustReplyEmpty
+        remotePutPacket("");
+    }
+    return false;
+}
+
 void remoteStepOverRange(char* p)
 {
     uint32_t address;
@@ -3817,8 +3953,7 @@ void remoteSetMemoryReadBreakPoint(char* p)
     int count;
     sscanf(p, ",%x,%x#", &address, &count);
 
-    for (int n = 0; n < count; n++)
-        addConditionalBreak(address + n, 0x02);
+    addBreakRange(address, count, 0x02);
 
     // Out of bounds memory checks
     //if (address < 0x2000000 || address > 0x3007fff) {
@@ -3846,19 +3981,11 @@ void remoteSetMemoryReadBreakPoint(char* p)
 
 void remoteClearMemoryReadBreakPoint(char* p)
 {
-    bool error = false;
-    int result;
     uint32_t address;
     int count;
     sscanf(p, ",%x,%x#", &address, &count);
 
-    for (int n = 0; n < count; n++) {
-        result = removeConditionalWithAddressAndFlag(address + n, 0x02, true);
-        if (result == -2)
-            error = true;
-    }
-
-    if (!error)
+    if (removeBreakRange(address, count, 0x02) != -2)
         remotePutPacket("OK");
     else
         remotePutPacket("");
@@ -3870,8 +3997,7 @@ void remoteSetMemoryAccessBreakPoint(char* p)
     int count;
     sscanf(p, ",%x,%x#", &address, &count);
 
-    for (int n = 0; n < count; n++)
-        addConditionalBreak(address + n, 0x03);
+    addBreakRange(address, count, 0x03);
 
     // Out of bounds memory checks
     //if (address < 0x2000000 || address > 0x3007fff) {
@@ -3899,19 +4025,11 @@ void remoteSetMemoryAccessBreakPoint(char* p)
 
 void remoteClearMemoryAccessBreakPoint(char* p)
 {
-    bool error = false;
-    int result;
     uint32_t address;
     int count;
     sscanf(p, ",%x,%x#", &address, &count);
 
-    for (int n = 0; n < count; n++) {
-        result = removeConditionalWithAddressAndFlag(address + n, 0x03, true);
-        if (result == -2)
-            error = true;
-    }
-
-    if (!error)
+    if (removeBreakRange(address, count, 0x03) != -2)
         remotePutPacket("OK");
     else
         remotePutPacket("");
@@ -3923,13 +4041,10 @@ void remoteWriteWatch(char* p, bool active)
     int count;
     sscanf(p, ",%x,%x#", &address, &count);
 
-    if (active) {
-        for (int n = 0; n < count; n++)
-            addConditionalBreak(address + n, 0x01);
-    } else {
-        for (int n = 0; n < count; n++)
-            removeConditionalWithAddressAndFlag(address + n, 0x01, true);
-    }
+    if (active)
+        addBreakRange(address, count, 0x01);
+    else
+        removeBreakRange(address, count, 0x01);
 
     // Out of bounds memory check
     //fprintf(stderr, "Write watch for %08x %d\n", address, count);
@@ -4123,7 +4238,8 @@ void remoteStubMain()
                 if ((i + 2) < res) {
                     if ((buffer[i + 1] == hex[csum >> 4]) && (buffer[i + 2] == hex[csum & 0xf])) {
                         ack = '+';
-                        remoteSendFnc(&ack, 1);
+                        if (!remoteNoAck)
+                            remoteSendFnc(&ack, 1);
                         //fprintf(stderr, "SentACK c=%c\n",c);
                         //process message...
                         char type;
@@ -4153,13 +4269,11 @@ void remoteStubMain()
                             debugger = false;
                             return;
                         case 's':
-                            remoteResumed = true;
-                            remoteSignal = 5;
-                            CPULoop(1);
-                            if (remoteResumed) {
-                                remoteResumed = false;
-                                remoteSendStatus();
-                            }
+                            remoteStep();
+                            break;
+                        case 'v':
+                            if (remoteVerbose(p))
+                                return;
                             break;
                         case 'g':
                             remoteReadRegisters(p);
@@ -4179,12 +4293,18 @@ void remoteStubMain()
                         case 'X':
                             remoteBinaryWrite(p);
                             break;
+                        case 'x':
+                            remoteBinaryRead(p);
+                            break;
                         case 'H':
                             remotePutPacket("OK");
                             break;
                         case 'q':
                             remoteQuery(p);
                             break;
+                        case 'Q':
+                            remoteSet(p);
+                            break;
                         case 'Z':
                             type = *p++;
                             if (type == '0') {
@@ -4224,9 +4344,11 @@ void remoteStubMain()
                         }
                     } else {
                         fprintf(stderr, "bad chksum csum=%x msg=%c%c\n", csum, buffer[i + 1], buffer[i + 2]);
-                        ack = '-';
-                        remoteSendFnc(&ack, 1);
-                        fprintf(stderr, "SentNACK\n");
+                        if (!remoteNoAck) {
+                            ack = '-';
+                            remoteSendFnc(&ack, 1);
+                            fprintf(stderr, "SentNACK\n");
+                        }
                     } //if
                     i += 3;
                 } else {
@@ -4254,6 +4376,7 @@ void remoteStubSignal(int sig, int number)
 
 void remoteCleanUp()
 {
+    remoteNoAck = false;
     if (remoteCleanUpFnc)
         remoteCleanUpFnc();
 }
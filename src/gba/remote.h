@@ -35,6 +35,12 @@ extern void dexp_listVars();
 extern void dexp_saveVars(char*);
 extern void dexp_loadVars(char*);
 
+// compiled expressions, for ones that are evaluated over and over
+struct dexp_code;
+extern struct dexp_code* dexp_compile(char*);
+extern uint32_t dexp_run(const struct dexp_code*);
+extern void dexp_free(struct dexp_code*);
+
 void debuggerOutput(const char* s, uint32_t addr);
 
 bool debuggerBreakOnExecution(uint32_t address, uint8_t state);
@@ -58,6 +64,7 @@ extern uint8_t highRegBreakCounter[4]; //(r8-r11)
 extern uint8_t statusRegBreakCounter[4]; //(r12-r15)
 
 extern bool enableRegBreak;
+extern bool breakpointsActive;
 extern regBreak* breakRegList[16];
 extern void breakReg_check(int i);
 
@@ -170,58 +170,13 @@ uint8_t *utilLoad(const char *file, bool (*accept)(const char *), uint8_t *data,
 
 void utilGBAFindSave(const int size)
 {
-    bool rtcFound_ = false;
-    int detectedSaveType = 0;
-    int flashSize_ = 0x10000;
-    uint32_t *p = (uint32_t *)&rom[0];
-    uint32_t *end = (uint32_t *)(&rom[0] + size);
-
-    while (p < end) {
-        uint32_t d = READ32LE(p);
-
-        if (d == 0x52504545) {
-            if (memcmp(p, "EEPROM_", 7) == 0) {
-                if (detectedSaveType == 0 || detectedSaveType == 4) {
-                    detectedSaveType = 1;
-                }
-            }
-        } else if (d == 0x4D415253) {
-            if (memcmp(p, "SRAM_", 5) == 0) {
-                if (detectedSaveType == 0 || detectedSaveType == 1
-                    || detectedSaveType == 4) {
-                    detectedSaveType = 2;
-                    flashSize_ = 0x8000;
-                }
-            }
-        } else if (d == 0x53414C46) {
-            if (memcmp(p, "FLASH1M_", 8) == 0) {
-                if (detectedSaveType == 0) {
-                    detectedSaveType = 3;
-                    flashSize_ = 0x20000;
-                }
-            } else if (memcmp(p, "FLASH512_", 9) == 0) {
-                if (detectedSaveType == 0) {
-                    detectedSaveType = 3;
-                    flashSize_ = 0x10000;
-                }
-            } else if (memcmp(p, "FLASH", 5) == 0) {
-                if (detectedSaveType == 0) {
-                    detectedSaveType = 4;
-                    flashSize_ = 0x10000;
-                }
-            }
-        } else if (d == 0x52494953) {
-            if (memcmp(p, "SIIRTC_V", 8) == 0) {
-                rtcFound_ = true;
-            }
-        }
-        p++;
-    }
-    // if no matches found, then set it to NONE
-    if (detectedSaveType == 0)
-        detectedSaveType = 5;
-    if (detectedSaveType == 4)
-        detectedSaveType = 3;
+    bool rtcFound_;
+    int flashSize_;
+    int detectedSaveType = utilGBAFindSaveType(rom, size, flashSize_, rtcFound_);
+
+    // the save memory exposed to the frontend is flashSize long, and SRAM is 32K
+    if (detectedSaveType == 2)
+        flashSize_ = 0x8000;
 
     cpuSaveType = detectedSaveType;
     rtcEnabled = rtcFound_;
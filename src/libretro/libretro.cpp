@@ -68,6 +68,22 @@ static unsigned systemHeight = gbaHeight;
 static EmulatedSystem* core = NULL;
 static IMAGE_TYPE type = IMAGE_UNKNOWN;
 
+// Video output. The renderers draw each frame straight into the
+// frontend's software framebuffer when it offers one in our pixel format
+// and layout, saving the copy video_cb() would otherwise make. Every line
+// drawn is also compared with the one drawn there before, so a frame that
+// repeats the last one sent is passed on as a dupe the frontend doesn't
+// need to upload.
+#define LINE_CACHE_WIDTH (gbaWidth * 4) // GBA lineMix, larger than gbLineMix
+#define LINE_CACHE_LINES gbaHeight
+static uint8_t line_cache[LINE_CACHE_LINES][LINE_CACHE_WIDTH];
+static bool line_drawn[LINE_CACHE_LINES];
+static bool track_lines;   // lines are being cached
+static bool frame_changed; // a line changed since the last frame sent
+static bool frame_sent;    // video_cb() was called this run
+static uint8_t* core_pix;  // the core's own buffer while pix is the frontend's
+static bool core_pix_stale; // the last frame was drawn into the frontend's
+
 // global vars
 uint16_t systemColorMap16[0x10000];
 uint32_t systemColorMap32[0x10000];
@@ -980,6 +996,7 @@ void retro_reset(void)
 {
     core->emuReset();
     set_gbPalette();
+    frame_changed = true;
 }
 
 #define MAX_PLAYERS 4
@@ -1222,8 +1239,10 @@ static void update_variables(bool startup)
     if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
         bool prev_lcdfilter = option_lcdfilter;
         option_lcdfilter = (!strcmp(var.value, "enabled")) ? true : false;
-        if (prev_lcdfilter != option_lcdfilter)
+        if (prev_lcdfilter != option_lcdfilter) {
             utilUpdateSystemColorMaps(option_lcdfilter);
+            frame_changed = true;
+        }
     }
 
     var.key = "vbam_interframeblending";
@@ -1445,6 +1464,84 @@ static void updateInput_Joypad(void)
     }
 }
 
+static void video_begin_frame(void)
+{
+    // interframe blending changes the picture on its own, and the SGB
+    // border isn't drawn by lines
+    bool track = !ifb_filter_func && !(type == IMAGE_GB && gbBorderOn);
+
+    if (track != track_lines) {
+        track_lines = track;
+        frame_changed = true;
+    }
+
+    memset(line_drawn, 0, sizeof(line_drawn));
+    frame_sent = false;
+    core_pix = pix;
+
+    if (!track_lines)
+        return;
+
+    struct retro_framebuffer fb;
+    memset(&fb, 0, sizeof(fb));
+    fb.width = systemWidth;
+    fb.height = systemHeight;
+    fb.access_flags = RETRO_MEMORY_ACCESS_WRITE;
+
+    enum retro_pixel_format format = systemColorDepth == 16 ? RETRO_PIXEL_FORMAT_RGB565 : RETRO_PIXEL_FORMAT_XRGB8888;
+
+    // the renderers assume a pitch of exactly one line
+    if (environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &fb) && fb.data
+        && fb.format == format && fb.pitch == systemWidth * (systemColorDepth >> 3))
+        pix = (uint8_t*)fb.data;
+}
+
+static void video_end_frame(void)
+{
+    pix = core_pix;
+
+    // a run without a frame (SGB screen mask) repeats the last one
+    if (!frame_sent && can_dupe)
+        video_cb(NULL, systemWidth, systemHeight, systemWidth * (systemColorDepth >> 3));
+}
+
+// the frontend's framebuffer starts out undefined, and the core's misses
+// the frames drawn there, so lines the core didn't draw this frame are
+// drawn again from the cache
+static void video_redraw_lines(void)
+{
+    for (unsigned y = 0; y < systemHeight; y++) {
+        if (line_drawn[y])
+            continue;
+
+        const uint32_t* gba = (const uint32_t*)line_cache[y];
+        const uint16_t* gb = (const uint16_t*)line_cache[y];
+
+        if (systemColorDepth == 16) {
+            uint16_t* dest = (uint16_t*)pix + y * systemWidth;
+            for (unsigned x = 0; x < systemWidth; x++)
+                dest[x] = systemColorMap16[type == IMAGE_GBA ? gba[x] & 0xFFFF : gb[x]];
+        } else {
+            uint32_t* dest = (uint32_t*)pix + y * systemWidth;
+            for (unsigned x = 0; x < systemWidth; x++)
+                dest[x] = systemColorMap32[type == IMAGE_GBA ? gba[x] & 0xFFFF : gb[x]];
+        }
+    }
+}
+
+void systemLineDrawn(int line, const void* colors, int size)
+{
+    if (!track_lines || line >= LINE_CACHE_LINES)
+        return;
+
+    line_drawn[line] = true;
+
+    if (memcmp(line_cache[line], colors, size)) {
+        memcpy(line_cache[line], colors, size);
+        frame_changed = true;
+    }
+}
+
 static bool firstrun = true;
 static unsigned has_frame;
 
@@ -1485,10 +1582,14 @@ void retro_run(void)
     updateInput_SolarSensor();
     updateInput_MotionSensors();
 
+    video_begin_frame();
+
     has_frame = 0;
 
     while (!has_frame)
         core->emuMain(core->emuCount);
+
+    video_end_frame();
 }
 
 static unsigned serialize_size = 0;
@@ -1781,9 +1882,30 @@ bool systemCanChangeSoundQuality(void)
 void systemDrawScreen(void)
 {
     unsigned pitch = systemWidth * (systemColorDepth >> 3);
-    if (ifb_filter_func)
-        ifb_filter_func(pix, pitch, systemWidth, systemHeight);
-    video_cb(pix, systemWidth, systemHeight, pitch);
+    bool dupe = false;
+
+    frame_sent = true;
+
+    if (track_lines) {
+        if (pix != core_pix || core_pix_stale)
+            video_redraw_lines();
+
+        core_pix_stale = pix != core_pix;
+        memset(line_drawn, 0, sizeof(line_drawn));
+        dupe = !frame_changed && can_dupe;
+        frame_changed = false;
+    }
+
+    if (dupe)
+        video_cb(NULL, systemWidth, systemHeight, pitch);
+    else {
+        if (ifb_filter_func)
+            ifb_filter_func(pix, pitch, systemWidth, systemHeight);
+        video_cb(pix, systemWidth, systemHeight, pitch);
+    }
+
+    // the frontend's framebuffer is its own again once it has the frame
+    pix = core_pix;
 }
 
 void systemSendScreen(void)
@@ -23,6 +23,10 @@
 #endif
 
 #include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,6 +52,7 @@
 #include "../Util.h"
 #include "../common/ConfigManager.h"
 #include "../common/Patch.h"
+#include "../common/RomDatabase.h"
 #include "../gb/gb.h"
 #include "../gb/gbCheats.h"
 #include "../gb/gbGlobals.h"
@@ -511,8 +516,16 @@ void sdlOpenGLInit(int w, int h)
     sdlOpenGLVideoResize();
 }
 
-static void sdlApplyPerImagePreferences()
+// settings of vba-over.ini by "[CODE]" section, read the first time a
+// GBA image is loaded
+typedef std::vector<std::pair<std::string, std::string> > ImagePreferences;
+static std::map<std::string, ImagePreferences> sdlImagePreferences;
+static bool sdlImagePreferencesRead = false;
+
+static void sdlReadImagePreferences()
 {
+    sdlImagePreferencesRead = true;
+
     FILE* f = sdlFindFile("vba-over.ini");
     if (!f) {
         fprintf(stdout, "vba-over.ini NOT FOUND (using emulator settings)\n");
@@ -520,18 +533,8 @@ static void sdlApplyPerImagePreferences()
     } else
         fprintf(stdout, "Reading vba-over.ini\n");
 
-    char buffer[7];
-    buffer[0] = '[';
-    buffer[1] = rom[0xac];
-    buffer[2] = rom[0xad];
-    buffer[3] = rom[0xae];
-    buffer[4] = rom[0xaf];
-    buffer[5] = ']';
-    buffer[6] = 0;
-
     char readBuffer[2048];
-
-    bool found = false;
+    ImagePreferences* section = NULL;
 
     while (1) {
         char* s = fgets(readBuffer, 2048, f);
@@ -540,62 +543,70 @@ static void sdlApplyPerImagePreferences()
             break;
 
         char* p = strchr(s, ';');
-
         if (p)
             *p = 0;
 
         char* token = strtok(s, " \t\n\r=");
-
         if (!token)
             continue;
         if (strlen(token) == 0)
             continue;
 
-        if (!strcmp(token, buffer)) {
-            found = true;
-            break;
+        if (token[0] == '[') {
+            // only the first section for an image counts
+            if (sdlImagePreferences.count(token))
+                section = NULL;
+            else
+                section = &sdlImagePreferences[token];
+            continue;
         }
-    }
+        if (!section)
+            continue;
+        char* value = strtok(NULL, "\t\n\r=");
+        if (value == NULL)
+            continue;
 
-    if (found) {
-        while (1) {
-            char* s = fgets(readBuffer, 2048, f);
+        section->push_back(std::make_pair(std::string(token), std::string(value)));
+    }
+    fclose(f);
+}
 
-            if (s == NULL)
-                break;
+static void sdlApplyPerImagePreferences()
+{
+    if (!sdlImagePreferencesRead)
+        sdlReadImagePreferences();
 
-            char* p = strchr(s, ';');
-            if (p)
-                *p = 0;
+    char buffer[7];
+    buffer[0] = '[';
+    buffer[1] = rom[0xac];
+    buffer[2] = rom[0xad];
+    buffer[3] = rom[0xae];
+    buffer[4] = rom[0xaf];
+    buffer[5] = ']';
+    buffer[6] = 0;
 
-            char* token = strtok(s, " \t\n\r=");
-            if (!token)
-                continue;
-            if (strlen(token) == 0)
-                continue;
+    std::map<std::string, ImagePreferences>::const_iterator it = sdlImagePreferences.find(buffer);
+    if (it == sdlImagePreferences.end())
+        return;
 
-            if (token[0] == '[') // starting another image settings
-                break;
-            char* value = strtok(NULL, "\t\n\r=");
-            if (value == NULL)
-                continue;
-
-            if (!strcmp(token, "rtcEnabled"))
-                rtcEnable(atoi(value) == 0 ? false : true);
-            else if (!strcmp(token, "flashSize")) {
-                int size = atoi(value);
-                if (size == 0x10000 || size == 0x20000)
-                    flashSetSize(size);
-            } else if (!strcmp(token, "saveType")) {
-                int save = atoi(value);
-                if (save >= 0 && save <= 5)
-                    cpuSaveType = save;
-            } else if (!strcmp(token, "mirroringEnabled")) {
-                mirroringEnable = (atoi(value) == 0 ? false : true);
-            }
+    for (size_t i = 0; i < it->second.size(); i++) {
+        const char* token = it->second[i].first.c_str();
+        const char* value = it->second[i].second.c_str();
+
+        if (!strcmp(token, "rtcEnabled"))
+            rtcEnable(atoi(value) == 0 ? false : true);
+        else if (!strcmp(token, "flashSize")) {
+            int size = atoi(value);
+            if (size == 0x10000 || size == 0x20000)
+                flashSetSize(size);
+        } else if (!strcmp(token, "saveType")) {
+            int save = atoi(value);
+            if (save >= 0 && save <= 5)
+                cpuSaveType = save;
+        } else if (!strcmp(token, "mirroringEnabled")) {
+            mirroringEnable = (atoi(value) == 0 ? false : true);
         }
     }
-    fclose(f);
 }
 
 static int sdlCalculateShift(uint32_t mask)
@@ -1461,6 +1472,7 @@ Long options only:\n\
       --no-throttle            Disable throttle\n\
       --pause-when-inactive    Pause when inactive\n\
       --rtc                    Enable RTC support\n\
+      --scan-roms=DIR          Add the ROMs under DIR to the ROM database\n\
       --show-speed-normal      Show emulation speed\n\
       --show-speed-detailed    Show detailed speed data\n\
       --cheat 'CHEAT'          Add a cheat\n\
@@ -1529,6 +1541,7 @@ int main(int argc, char** argv)
     SetHome(home);
     SetHomeConfigDir();
     SetHomeDataDir();
+    utilSetArchiveCacheDir((std::string(homeDataDir) + FILE_SEP + "archive-cache").c_str());
 
     frameSkip = 2;
     gbBorderOn = 0;
@@ -1619,6 +1632,14 @@ int main(int argc, char** argv)
         exit(-1);
     }
 
+    if (scanRomsDir) {
+        RomDatabase romDatabase;
+        romDatabase.Load((std::string(homeDataDir) + FILE_SEP + "rom-database.txt").c_str());
+        int scanned = romDatabase.Scan(scanRomsDir);
+        fprintf(stdout, "%d images scanned, %d in the ROM database\n", scanned, (int)romDatabase.Entries().size());
+        exit(romDatabase.Save() ? 0 : -1);
+    }
+
     if (!debugger) {
         if (optind >= argc) {
             systemMessage(0, "Missing image name");
@@ -1184,6 +1184,19 @@ EVT_HANDLER_MASK(ScreenCapture, "Screen capture...", CMDEN_GB | CMDEN_GBA)
     systemScreenMessage(msg);
 }
 
+EVT_HANDLER_MASK(ScreenCaptureBurst, "Screen capture burst...", CMDEN_GB | CMDEN_GBA)
+{
+    long frames;
+    {
+        ModalPause mp;
+        frames = wxGetNumberFromUser(_("Number of frames to capture:"), wxEmptyString,
+            _("Screen capture burst"), 60, 1, 3600, this);
+    }
+
+    if (frames > 0)
+        panel->capture_burst = frames;
+}
+
 EVT_HANDLER_MASK(RecordSoundStartRecording, "Start sound recording...", CMDEN_NSREC)
 {
 #ifndef NO_FFMPEG
@@ -1367,6 +1380,21 @@ EVT_HANDLER_MASK(PlayMovieStopPlaying, "Stop playing movie", CMDEN_GPLAY)
     systemStopGamePlayback();
 }
 
+extern uint32_t game_frame;
+
+EVT_HANDLER_MASK(PlayMovieSeek, "Seek movie to frame...", CMDEN_GPLAY)
+{
+    long frame;
+    {
+        ModalPause mp;
+        frame = wxGetNumberFromUser(_("Frame to seek to:"), wxEmptyString,
+            _("Seek movie"), game_frame, 0, 0x7fffffff, this);
+    }
+
+    if (frame >= 0)
+        systemSeekGamePlayback(frame);
+}
+
 // formerly Close
 EVT_HANDLER_MASK(wxID_CLOSE, "Close", CMDEN_GB | CMDEN_GBA)
 {
@@ -55,6 +55,17 @@ public:
         selx = sely = -1;
         Update();
     }
+    bool SourceChanged()
+    {
+        Watch(&DISPCNT, sizeof(DISPCNT));
+        Watch(&BG0CNT, sizeof(BG0CNT));
+        Watch(&BG1CNT, sizeof(BG1CNT));
+        Watch(&BG2CNT, sizeof(BG2CNT));
+        Watch(&BG3CNT, sizeof(BG3CNT));
+        Watch(paletteRAM, 0x200);
+        Watch(vram, 0x18000);
+        return WatchChanged();
+    }
     void Update()
     {
         mode = DISPCNT & 7;
@@ -581,6 +592,16 @@ public:
         selx = sely = -1;
         Update();
     }
+    bool SourceChanged()
+    {
+        if (gbCgbMode)
+            Watch(gbVram, 0x4000);
+        else
+            Watch(&gbMemory[0x8000], 0x2000);
+        Watch(gbPalette, sizeof(gbPalette));
+        Watch(gbBgp, sizeof(gbBgp));
+        return WatchChanged();
+    }
     void Update()
     {
         uint8_t *bank0, *bank1;
@@ -1009,6 +1030,19 @@ public:
         Fit();
         Update();
     }
+    bool SourceChanged()
+    {
+        Watch(&gbMemory[0xfe00 + sprite * 4], 4);
+        Watch(&register_LCDC, sizeof(register_LCDC));
+        if (gbCgbMode)
+            Watch(gbVram, 0x4000);
+        else
+            Watch(&gbMemory[0x8000], 0x2000);
+        Watch(gbPalette, sizeof(gbPalette));
+        Watch(gbObp0, sizeof(gbObp0));
+        Watch(gbObp1, sizeof(gbObp1));
+        return WatchChanged();
+    }
     void Update()
     {
         uint8_t* bmp = image.GetData();
@@ -1221,6 +1255,11 @@ public:
         Fit();
         Update();
     }
+    bool SourceChanged()
+    {
+        Watch(paletteRAM, 0x400);
+        return WatchChanged();
+    }
     void Update()
     {
         if (paletteRAM) {
@@ -1343,6 +1382,11 @@ public:
         Fit();
         Update();
     }
+    bool SourceChanged()
+    {
+        Watch(gbPalette, sizeof(gbPalette));
+        return WatchChanged();
+    }
     void Update()
     {
         uint16_t* pp = gbPalette;
@@ -1470,6 +1514,19 @@ public:
         uint16_t* palette = (uint16_t*)paletteRAM;
         uint8_t* charBase = &vram[charbase];
         int maxY;
+        // only tiles whose data changed since they were drawn are drawn
+        // again, unless the palette or the settings changed as well
+        bool all = shown_tiles.empty() || is256 != shown_is256 || charbase != shown_charbase
+            || this->palette != shown_palette || memcmp(&shown_colors[0], paletteRAM, 0x400);
+        bool drawn = false;
+
+        if (all) {
+            shown_tiles.resize(32 * 32 * 32);
+            shown_colors.assign(paletteRAM, paletteRAM + 0x400);
+            shown_is256 = is256;
+            shown_charbase = charbase;
+            shown_palette = this->palette;
+        }
 
         if (is256) {
             int tile = 0;
@@ -1477,10 +1534,16 @@ public:
 
             for (int y = 0; y < maxY; y++) {
                 for (int x = 0; x < 32; x++) {
-                    if (charbase == 4 * 0x4000)
-                        render256(tile, x, y, charBase, &palette[256]);
-                    else
-                        render256(tile, x, y, charBase, palette);
+                    if (all || memcmp(&shown_tiles[tile * 64], &charBase[tile * 64], 64)) {
+                        memcpy(&shown_tiles[tile * 64], &charBase[tile * 64], 64);
+
+                        if (charbase == 4 * 0x4000)
+                            render256(tile, x, y, charBase, &palette[256]);
+                        else
+                            render256(tile, x, y, charBase, palette);
+
+                        drawn = true;
+                    }
 
                     tile++;
                 }
@@ -1496,7 +1559,12 @@ public:
 
             for (int y = 0; y < maxY; y++) {
                 for (int x = 0; x < 32; x++) {
-                    render16(tile, x, y, charBase, palette);
+                    if (all || memcmp(&shown_tiles[tile * 32], &charBase[tile * 32], 32)) {
+                        memcpy(&shown_tiles[tile * 32], &charBase[tile * 32], 32);
+                        render16(tile, x, y, charBase, palette);
+                        drawn = true;
+                    }
+
                     tile++;
                 }
             }
@@ -1504,7 +1572,9 @@ public:
             BMPSize(32 * 8, maxY * 8);
         }
 
-        ChangeBMP();
+        if (drawn)
+            ChangeBMP();
+
         UpdateMouseInfo();
     }
     void UpdateMouseInfoEv(wxMouseEvent& ev)
@@ -1624,6 +1694,9 @@ protected:
     int charbase, is256, palette;
     wxControl *tileno, *addr;
     int selx, sely;
+    // what the image currently shows
+    std::vector<uint8_t> shown_tiles, shown_colors;
+    int shown_charbase, shown_is256, shown_palette;
 
     DECLARE_EVENT_TABLE()
 };
@@ -1650,10 +1723,20 @@ public:
         Fit();
         Update();
     }
+    bool SourceChanged()
+    {
+        if (gbCgbMode)
+            Watch(gbVram, 0x4000);
+        else
+            Watch(&gbMemory[0x8000], 0x2000);
+        Watch(gbPalette, sizeof(gbPalette));
+        Watch(gbBgp, sizeof(gbBgp));
+        return WatchChanged();
+    }
     void Update()
     {
         // following copied almost verbatim from GBTileView.cpp
-        uint8_t* charBase = (gbVram != NULL) ? &gbVram[bank + charbase] : &gbMemory[0x8000 + charbase];
+        uint8_t* charBase = gbCgbMode ? &gbVram[bank + charbase] : &gbMemory[0x8000 + charbase];
         int tile = 0;
 
         for (int y = 0; y < 16; y++) {
@@ -240,6 +240,7 @@ opt_desc opts[] = {
     BOOLOPT("General/FreezeRecent", "", wxTRANSLATE("Freeze recent load list"), gopts.recent_freeze),
     STROPT("General/RecordingDir", "", wxTRANSLATE("Directory to store A/V and game recordings (relative paths are relative to ROM)"), gopts.recording_dir),
     INTOPT("General/RewindInterval", "", wxTRANSLATE("Number of seconds between rewind snapshots (0 to disable)"), gopts.rewind_interval, 0, 600),
+    INTOPT("General/ScreenshotCompression", "", wxTRANSLATE("PNG screenshot compression level (0 = fastest, 9 = smallest)"), gopts.scrshot_compression, 0, 9),
     STROPT("General/ScreenshotDir", "", wxTRANSLATE("Directory to store screenshots (relative paths are relative to ROM)"), gopts.scrshot_dir),
     STROPT("General/StateDir", "", wxTRANSLATE("Directory to store saved state files (relative paths are relative to BatteryDir)"), gopts.state_dir),
     INTOPT("General/StatusBar", "StatusBar", wxTRANSLATE("Enable status bar"), gopts.statusbar, 0, 1),
@@ -371,6 +372,8 @@ opts_t::opts_t()
     server_ip = "*";
     link_port = 5738;
 
+    scrshot_compression = 8;
+
     hide_menu_bar = true;
 }
 
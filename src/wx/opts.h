@@ -52,6 +52,7 @@ extern struct opts_t {
     bool recent_freeze;
     wxString recording_dir;
     int rewind_interval;
+    int scrshot_compression;
     wxString scrshot_dir;
     wxString state_dir;
     int statusbar;
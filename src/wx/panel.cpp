@@ -55,6 +55,7 @@ GameArea::GameArea()
     , paused(false)
     , pointer_blanked(false)
     , mouse_active_time(0)
+    , capture_burst(0)
 {
     SetSizer(new wxBoxSizer(wxVERTICAL));
     // all renderers prefer 32-bit
@@ -64,6 +65,18 @@ GameArea::GameArea()
     Init_2xSaI(32);
 }
 
+// battery memory as the core holds it, if its file is a plain dump
+static uint8_t* battery_data(IMAGE_TYPE loaded, int& size)
+{
+    if (loaded == IMAGE_GB)
+        return gbBatteryData(size);
+
+    if (loaded == IMAGE_GBA)
+        return CPUBatteryData(size);
+
+    return NULL;
+}
+
 void GameArea::LoadGame(const wxString& name)
 {
     rom_scene_rls = wxT("-");
@@ -375,6 +388,12 @@ void GameArea::LoadGame(const wxString& name)
         wxFileName bat(batdir, bname);
 
         if (emusys->emuReadBattery(UTF8(bat.GetFullPath()))) {
+            int size;
+            uint8_t* data = battery_data(loaded, size);
+
+            if (data)
+                BatteryJournal::Replay(UTF8(bat.GetFullPath()), data, size);
+
             wxString msg;
             msg.Printf(_("Loaded battery %s"), bat.GetFullPath().wc_str());
             systemScreenMessage(msg);
@@ -530,6 +549,11 @@ void GameArea::UnloadGame(bool destruct)
         SaveBattery();
     }
 
+    // folds the journal back into the battery file
+    battery_journal.Close();
+    capture_burst = 0;
+    screenshot_writer.Flush();
+
     MainFrame* mf = wxGetApp().frame;
 #ifndef NO_FFMPEG
     snd_rec.Stop();
@@ -679,11 +703,29 @@ void GameArea::SaveBattery()
     bat.Mkdir(0777, wxPATH_MKDIR_FULL);
     wxString fn = bat.GetFullPath();
 
+    // journal the changes in the background where the core allows it
+    int size;
+    uint8_t* data = battery_data(loaded, size);
+
+    if (data) {
+        if (!battery_journal.IsOpen() || battery_journal.GetFileName() != (const char*)UTF8(fn))
+            battery_journal.Open(UTF8(fn), size);
+
+        if (battery_journal.Save(data, size)) {
+            systemSaveUpdateCounter = SYSTEM_SAVE_NOT_UPDATED;
+            return;
+        }
+    }
+
+    battery_journal.Close();
+
     // FIXME: add option to support ring of backups
     // of course some games just write battery way too often for such
     // a thing to be useful
     if (!emusys->emuWriteBattery(UTF8(fn)))
         wxLogError(_("Error writing battery %s"), fn.mb_str());
+    else
+        BatteryJournal::Remove(UTF8(fn));
 
     systemSaveUpdateCounter = SYSTEM_SAVE_NOT_UPDATED;
 }
@@ -1136,6 +1178,12 @@ void GameArea::OnIdle(wxIdleEvent& event)
 #endif
 
         emusys->emuMain(emusys->emuCount);
+        systemUpdateGameRecording();
+
+        std::vector<std::string> failed = screenshot_writer.TakeFailures();
+
+        for (size_t i = 0; i < failed.size(); i++)
+            wxLogError(_("Error saving snapshot file %s"), wxString(failed[i].c_str(), wxConvUTF8).c_str());
 #ifndef NO_LINK
 
         if (loaded == IMAGE_GBA && GetLinkMode() != LINK_DISCONNECTED)
@@ -2425,6 +2473,21 @@ static const wxString media_err(recording::MediaRet ret)
     }
 }
 
+// the recorder drops video and holds up emulation for audio rather than
+// fall behind; say so
+static void media_report_drops(recording::MediaRecorder& rec)
+{
+    recording::MediaStats stats = rec.GetStats();
+
+    if (stats.droppedVideo)
+        wxLogWarning(_("%u of %u video frames were dropped while recording"),
+            stats.droppedVideo, stats.videoFrames + stats.droppedVideo);
+
+    if (stats.stalledAudio)
+        wxLogWarning(_("Emulation waited for the encoder on %u of %u audio frames while recording"),
+            stats.stalledAudio, stats.audioFrames);
+}
+
 void GameArea::StartVidRecording(const wxString& fname)
 {
     recording::MediaRet ret;
@@ -2446,6 +2509,7 @@ void GameArea::StartVidRecording(const wxString& fname)
 void GameArea::StopVidRecording()
 {
     vid_rec.Stop();
+    media_report_drops(vid_rec);
     MainFrame* mf = wxGetApp().frame;
     mf->cmd_enable &= ~CMDEN_VREC;
     mf->cmd_enable |= CMDEN_NVREC;
@@ -2475,6 +2539,7 @@ void GameArea::StartSoundRecording(const wxString& fname)
 void GameArea::StopSoundRecording()
 {
     snd_rec.Stop();
+    media_report_drops(snd_rec);
     MainFrame* mf = wxGetApp().frame;
     mf->cmd_enable &= ~CMDEN_SREC;
     mf->cmd_enable |= CMDEN_NSREC;
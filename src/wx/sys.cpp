@@ -2,7 +2,10 @@
 #include "../common/SoundSDL.h"
 #include "wxvbam.h"
 #include "SDL.h"
+#include <algorithm>
+#include <vector>
 #include <wx/ffile.h>
+#include <wx/filename.h>
 #include <wx/generic/prntdlgg.h>
 #include <wx/print.h>
 #include <wx/printdlg.h>
@@ -89,6 +92,14 @@ void systemDrawScreen()
     mf->UpdateViewers();
     // FIXME: Sm60FPS crap and sondBufferLow crap
     GameArea* ga = mf->GetPanel();
+
+    if (ga && ga->capture_burst) {
+        systemScreenCapture(0);
+
+        if (!--ga->capture_burst)
+            systemScreenMessage(_("Capture burst finished"));
+    }
+
 #ifndef NO_FFMPEG
 
     if (ga)
@@ -105,17 +116,224 @@ void systemDrawScreen()
 // doesn't work in GB "multiplayer" mode (only records default joypad)
 //
 //  <name>.vmv = keystroke log; all values little-endian ints:
-//     <version>.32 = 1
+//     <version>.32 = 2 (version 1 has no keyframes and no index)
 //     for every joypad change (init to 0) and once at end of movie {
 //        <timestamp>.32 = frames since start of movie
 //        <joypad>.32 = default joypad reading at that time
 //     }
+//     interleaved with the above, every MOVIE_KEYFRAME_INTERVAL frames {
+//        <marker>.32 = MOVIE_KEYFRAME_MARKER
+//        <timestamp>.32 = frames since start of movie
+//        <joypad>.32 = default joypad reading at that time
+//        <size>.32 = size of state
+//        <state> = compressed memory save state
+//     }
+//     index, written when recording stops {
+//        for every keyframe {
+//           <timestamp>.32 = frames since start of movie
+//           <offset>.32 = file offset of keyframe marker
+//        }
+//        <count>.32 = number of keyframes
+//        <offset>.32 = file offset of index
+//        <magic>.32 = MOVIE_INDEX_MAGIC
+//     }
 //  <name>.vm0 = saved state
+//
+// Keyframes are only written for cores that can save state to memory;
+// seeking restores the nearest keyframe (or the .vm0) and emulates the
+// remaining frames, so it never replays more than one interval.
+
+#define MOVIE_VERSION 2
+#define MOVIE_KEYFRAME_MARKER 0xffffffff
+#define MOVIE_INDEX_MAGIC 0x49564d56 // "VMVI"
+#define MOVIE_KEYFRAME_INTERVAL (60 * 60)
+
+struct movie_keyframe {
+    uint32_t frame;
+    uint32_t offset;
+};
+
+static bool movie_keyframe_before(uint32_t frame, const movie_keyframe& kf)
+{
+    return frame < kf.frame;
+}
 
 wxFFile game_file;
 bool game_recording, game_playback;
 uint32_t game_frame;
 uint32_t game_joypad;
+static wxString game_fname;
+static std::vector<movie_keyframe> game_keyframes;
+static uint32_t game_next_keyframe;
+static wxFileOffset game_records_end, game_next_offset;
+
+static bool game_write32(uint32_t v)
+{
+    v = wxUINT32_SWAP_ON_BE(v);
+    return game_file.Write(&v, sizeof(v)) == sizeof(v);
+}
+
+static bool game_read32(uint32_t& v)
+{
+    if (game_file.Read(&v, sizeof(v)) != sizeof(v))
+        return false;
+
+    v = wxUINT32_SWAP_ON_BE(v);
+    return true;
+}
+
+static wxString game_state_name(const wxString& fname)
+{
+    wxString fn = fname;
+    fn[fn.size() - 1] = wxT('0');
+    return fn;
+}
+
+// buffer for keyframe states; same bound as rewind states
+static std::vector<char>& game_state_buffer()
+{
+    static std::vector<char> buf;
+
+    if (buf.empty())
+        buf.resize(REWIND_SIZE);
+
+    return buf;
+}
+
+// append a keyframe of the current state; a state that does not fit
+// is skipped, only file errors are fatal
+static bool game_write_keyframe()
+{
+    GameArea* panel = wxGetApp().frame->GetPanel();
+    std::vector<char>& buf = game_state_buffer();
+    long size;
+
+    if (!panel->emusys->emuWriteMemState(&buf[0], (int)buf.size(), size)) {
+        wxLogInfo(_("Error writing movie keyframe"));
+        return true;
+    }
+
+    movie_keyframe kf = { game_frame, (uint32_t)game_file.Tell() };
+
+    if (!game_write32(MOVIE_KEYFRAME_MARKER) || !game_write32(game_frame) || !game_write32(game_joypad) || !game_write32(size) || game_file.Write(&buf[0], size) != (size_t)size)
+        return false;
+
+    game_keyframes.push_back(kf);
+    return true;
+}
+
+// read the next joypad change, skipping over keyframes (and collecting
+// them in found, if given)
+static bool game_read_record(uint32_t& frame, uint32_t& joypad, std::vector<movie_keyframe>* found = NULL)
+{
+    for (;;) {
+        game_next_offset = game_file.Tell();
+
+        if (game_next_offset >= game_records_end || !game_read32(frame) || !game_read32(joypad))
+            return false;
+
+        if (frame != MOVIE_KEYFRAME_MARKER)
+            return true;
+
+        // joypad holds the keyframe's timestamp here
+        movie_keyframe kf = { joypad, (uint32_t)game_next_offset };
+        uint32_t jp, size;
+
+        if (!game_read32(jp) || !game_read32(size) || !game_file.Seek(size, wxFromCurrent))
+            return false;
+
+        if (found)
+            found->push_back(kf);
+    }
+}
+
+// find the keyframes and the end of the input records, from the index
+// if there is one, otherwise by walking the records
+static void game_load_index(uint32_t version)
+{
+    game_keyframes.clear();
+    game_records_end = game_file.Length();
+
+    if (version < 2)
+        return;
+
+    uint32_t count, offset, magic;
+
+    if (game_records_end >= 16 && game_file.Seek(game_records_end - 12) && game_read32(count) && game_read32(offset) && game_read32(magic) && magic == MOVIE_INDEX_MAGIC && offset + (wxFileOffset)count * 8 + 12 == game_records_end && game_file.Seek(offset)) {
+        game_keyframes.resize(count);
+
+        for (uint32_t i = 0; i < count; i++)
+            if (!game_read32(game_keyframes[i].frame) || !game_read32(game_keyframes[i].offset)) {
+                game_keyframes.clear();
+                break;
+            }
+
+        game_records_end = offset;
+    } else {
+        // no index; recording was cut short
+        uint32_t gf, jp;
+        game_file.Seek(sizeof(uint32_t));
+
+        while (game_read_record(gf, jp, &game_keyframes))
+            ;
+    }
+
+    game_file.Seek(sizeof(uint32_t));
+}
+
+// copy the part of the movie being played back up to the current
+// frame into a new recording, which then carries on from here
+static bool game_branch_recording(const wxString& fn)
+{
+    if (wxFileName(fn).SameAs(wxFileName(game_fname))) {
+        wxLogError(_("Cannot record over the movie being played"));
+        return false;
+    }
+
+    wxFFile src;
+    wxFileOffset end = game_next_offset;
+
+    if (!src.Open(game_fname, wxT("rb")) || !src.Seek(sizeof(uint32_t)) || !wxCopyFile(game_state_name(game_fname), game_state_name(fn))) {
+        wxLogError(_("Error reading game recording"));
+        return false;
+    }
+
+    std::vector<movie_keyframe> keyframes;
+
+    // keyframes past the current frame belong to the old timeline
+    for (size_t i = 0; i < game_keyframes.size() && game_keyframes[i].offset < end; i++) {
+        if (game_keyframes[i].frame > game_frame) {
+            end = game_keyframes[i].offset;
+            break;
+        }
+
+        keyframes.push_back(game_keyframes[i]);
+    }
+
+    systemStopGamePlayback();
+
+    if (!game_file.Open(fn, wxT("wb")) || !game_write32(MOVIE_VERSION)) {
+        wxLogError(_("Cannot open output file %s"), fn.c_str());
+        return false;
+    }
+
+    char buf[0x10000];
+
+    for (wxFileOffset pos = sizeof(uint32_t); pos < end;) {
+        size_t len = end - pos < (wxFileOffset)sizeof(buf) ? (size_t)(end - pos) : sizeof(buf);
+
+        if (src.Read(buf, len) != len || game_file.Write(buf, len) != len) {
+            wxLogError(_("Error writing game recording"));
+            game_file.Close();
+            return false;
+        }
+
+        pos += len;
+    }
+
+    game_keyframes.swap(keyframes);
+    return true;
+}
 
 void systemStartGameRecording(const wxString& fname)
 {
@@ -126,29 +344,34 @@ void systemStartGameRecording(const wxString& fname)
         return;
     }
 
-    systemStopGamePlayback();
     wxString fn = fname;
 
     if (fn.size() < 4 || !wxString(fn.substr(fn.size() - 4)).IsSameAs(wxT(".vmv"), false))
         fn.append(wxT(".vmv"));
 
-    uint32_t version = 1;
-
-    if (!game_file.Open(fn, wxT("wb")) || game_file.Write(&version, sizeof(version)) != sizeof(version)) {
-        wxLogError(_("Cannot open output file %s"), fname.c_str());
-        return;
-    }
+    if (game_playback) {
+        // keep game_frame and game_joypad where playback left them
+        if (!game_branch_recording(fn))
+            return;
+    } else {
+        if (!game_file.Open(fn, wxT("wb")) || !game_write32(MOVIE_VERSION)) {
+            wxLogError(_("Cannot open output file %s"), fname.c_str());
+            return;
+        }
 
-    fn[fn.size() - 1] = wxT('0');
+        if (!panel->emusys->emuWriteState(UTF8(game_state_name(fn)))) {
+            wxLogError(_("Error writing game recording"));
+            game_file.Close();
+            return;
+        }
 
-    if (!panel->emusys->emuWriteState(UTF8(fn))) {
-        wxLogError(_("Error writing game recording"));
-        game_file.Close();
-        return;
+        game_frame = 0;
+        game_joypad = 0;
+        game_keyframes.clear();
     }
 
-    game_frame = 0;
-    game_joypad = 0;
+    game_fname = fn;
+    game_next_keyframe = game_frame + MOVIE_KEYFRAME_INTERVAL;
     game_recording = true;
     MainFrame* mf = wxGetApp().frame;
     mf->cmd_enable &= ~(CMDEN_NGREC | CMDEN_GPLAY | CMDEN_NGPLAY);
@@ -161,7 +384,15 @@ void systemStopGameRecording()
     if (!game_recording)
         return;
 
-    if (game_file.Write(&game_frame, sizeof(game_frame)) != sizeof(game_frame) || game_file.Write(&game_joypad, sizeof(game_joypad)) != sizeof(game_joypad) || !game_file.Close())
+    bool ok = game_write32(game_frame) && game_write32(game_joypad);
+    uint32_t index = game_file.Tell();
+
+    for (size_t i = 0; ok && i < game_keyframes.size(); i++)
+        ok = game_write32(game_keyframes[i].frame) && game_write32(game_keyframes[i].offset);
+
+    ok = ok && game_write32((uint32_t)game_keyframes.size()) && game_write32(index) && game_write32(MOVIE_INDEX_MAGIC);
+
+    if (!game_file.Close() || !ok)
         wxLogError(_("Error writing game recording"));
 
     game_recording = false;
@@ -171,6 +402,23 @@ void systemStopGameRecording()
     mf->enable_menus();
 }
 
+// called between emulation slices, where it is safe to save state
+void systemUpdateGameRecording()
+{
+    if (!game_recording || game_frame < game_next_keyframe)
+        return;
+
+    game_next_keyframe = game_frame + MOVIE_KEYFRAME_INTERVAL;
+
+    if (!wxGetApp().frame->GetPanel()->emusys->emuWriteMemState)
+        return;
+
+    if (!game_write_keyframe()) {
+        wxLogError(_("Error writing game recording"));
+        systemStopGameRecording();
+    }
+}
+
 uint32_t game_next_frame, game_next_joypad;
 
 void systemStartGamePlayback(const wxString& fname)
@@ -195,34 +443,32 @@ void systemStartGamePlayback(const wxString& fname)
 
     uint32_t version;
 
-    if (!game_file.Open(fn, wxT("rb")) || game_file.Read(&version, sizeof(version)) != sizeof(version) || wxUINT32_SWAP_ON_BE(version) != 1) {
+    if (!game_file.Open(fn, wxT("rb")) || !game_read32(version) || version < 1 || version > MOVIE_VERSION) {
         wxLogError(_("Cannot open recording file %s"), fname.c_str());
         return;
     }
 
-    uint32_t gf, jp;
+    game_load_index(version);
 
-    if (game_file.Read(&gf, sizeof(gf)) != sizeof(gf) || game_file.Read(&jp, sizeof(jp)) != sizeof(jp)) {
+    if (!game_read_record(game_next_frame, game_next_joypad)) {
         wxLogError(_("Error reading game recording"));
         game_file.Close();
         return;
     }
 
-    game_next_frame = wxUINT32_SWAP_ON_BE(gf);
-    game_next_joypad = wxUINT32_SWAP_ON_BE(jp);
-    fn[fn.size() - 1] = wxT('0');
-
-    if (!panel->emusys->emuReadState(UTF8(fn))) {
+    if (!panel->emusys->emuReadState(UTF8(game_state_name(fn)))) {
         wxLogError(_("Error reading game recording"));
         game_file.Close();
         return;
     }
 
+    game_fname = fn;
     game_frame = 0;
     game_joypad = 0;
     game_playback = true;
     MainFrame* mf = wxGetApp().frame;
-    mf->cmd_enable &= ~(CMDEN_NGREC | CMDEN_GREC | CMDEN_NGPLAY);
+    // starting a recording during playback branches off the movie
+    mf->cmd_enable &= ~(CMDEN_GREC | CMDEN_NGPLAY);
     mf->cmd_enable |= CMDEN_GPLAY;
     mf->enable_menus();
 }
@@ -240,6 +486,44 @@ void systemStopGamePlayback()
     mf->enable_menus();
 }
 
+// restore the nearest keyframe (or the starting state) at or before
+// frame and emulate the rest of the way
+void systemSeekGamePlayback(uint32_t frame)
+{
+    if (!game_playback)
+        return;
+
+    GameArea* panel = wxGetApp().frame->GetPanel();
+    std::vector<movie_keyframe>::iterator kf = std::upper_bound(game_keyframes.begin(), game_keyframes.end(), frame, movie_keyframe_before);
+    uint32_t from = kf == game_keyframes.begin() ? 0 : (kf - 1)->frame;
+
+    // moving forward within the current interval; just run
+    if (frame < game_frame || from > game_frame) {
+        bool ok;
+
+        if (kf == game_keyframes.begin()) {
+            ok = game_file.Seek(sizeof(uint32_t)) && panel->emusys->emuReadState(UTF8(game_state_name(game_fname)));
+            game_frame = 0;
+            game_joypad = 0;
+        } else {
+            std::vector<char>& buf = game_state_buffer();
+            uint32_t marker, gf, size;
+            --kf;
+            ok = game_file.Seek(kf->offset) && game_read32(marker) && game_read32(gf) && game_read32(game_joypad) && game_read32(size) && size <= buf.size() && game_file.Read(&buf[0], size) == size && panel->emusys->emuReadMemState(&buf[0], (int)size);
+            game_frame = gf;
+        }
+
+        if (!ok || !game_read_record(game_next_frame, game_next_joypad)) {
+            wxLogError(_("Error reading game recording"));
+            systemStopGamePlayback();
+            return;
+        }
+    }
+
+    while (game_playback && game_frame < frame)
+        panel->emusys->emuMain(panel->emusys->emuCount);
+}
+
 // updates the joystick data (done in background using wxSDLJoy)
 bool systemReadJoypads()
 {
@@ -302,10 +586,8 @@ uint32_t systemReadJoypad(int joy)
 
         if (rret != game_joypad) {
             game_joypad = rret;
-            uint32_t gf = wxUINT32_SWAP_ON_BE(game_frame);
-            uint32_t jp = wxUINT32_SWAP_ON_BE(game_joypad);
 
-            if (game_file.Write(&gf, sizeof(gf)) != sizeof(gf) || game_file.Write(&jp, sizeof(jp)) != sizeof(jp)) {
+            if (!game_write32(game_frame) || !game_write32(game_joypad)) {
                 game_file.Close();
                 game_recording = false;
                 wxLogError(_("Error writing game recording"));
@@ -314,18 +596,14 @@ uint32_t systemReadJoypad(int joy)
     } else if (game_playback) {
         while (game_frame >= game_next_frame) {
             game_joypad = game_next_joypad;
-            uint32_t gf, jp;
 
-            if (game_file.Read(&gf, sizeof(gf)) != sizeof(gf) || game_file.Read(&jp, sizeof(jp)) != sizeof(jp)) {
+            if (!game_read_record(game_next_frame, game_next_joypad)) {
                 game_file.Close();
                 game_playback = false;
                 wxString msg(_("Playback ended"));
                 systemScreenMessage(msg);
                 break;
             }
-
-            game_next_frame = wxUINT32_SWAP_ON_BE(gf);
-            game_next_joypad = wxUINT32_SWAP_ON_BE(jp);
         }
 
         ret = game_joypad;
@@ -425,30 +703,46 @@ void systemScreenCapture(int num)
 {
     GameArea* panel = wxGetApp().frame->GetPanel();
     wxFileName fn = wxFileName(wxGetApp().frame->GetGamePath(gopts.scrshot_dir), wxEmptyString);
+    // numbers already taken are remembered, so a burst does not probe the
+    // same files again for every frame, and captures still being written
+    // are not picked twice
+    static wxString last_prefix;
+    static int next_num;
+    wxString ext = captureFormat == 0 ? wxT(".png") : wxT(".bmp");
+    wxString prefix = fn.GetPath() + panel->game_name() + ext;
+
+    if (prefix == last_prefix && num < next_num)
+        num = next_num;
 
     do {
         wxString bfn;
         bfn.Printf(wxT("%s%02d"), panel->game_name().c_str(),
             num++);
-
-        if (captureFormat == 0)
-            bfn.append(wxT(".png"));
-        else // if(gopts.cap_format == 1)
-            bfn.append(wxT(".bmp"));
-
+        bfn.append(ext);
         fn.SetFullName(bfn);
     } while (fn.FileExists());
 
-    fn.Mkdir(0777, wxPATH_MKDIR_FULL);
+    last_prefix = prefix;
+    next_num = num;
 
-    if (captureFormat == 0)
-        panel->emusys->emuWritePNG(UTF8(fn.GetFullPath()));
-    else // if(gopts.cap_format == 1)
-        panel->emusys->emuWriteBMP(UTF8(fn.GetFullPath()));
+    if (!fn.DirExists())
+        fn.Mkdir(0777, wxPATH_MKDIR_FULL);
+
+    int w = 240, h = 160;
+
+    if (panel->game_type() == IMAGE_GB) {
+        w = gbBorderOn ? 256 : 160;
+        h = gbBorderOn ? 224 : 144;
+    }
 
-    wxString msg;
-    msg.Printf(_("Wrote snapshot %s"), fn.GetFullPath().wc_str());
-    systemScreenMessage(msg);
+    panel->screenshot_writer.Capture(UTF8(fn.GetFullPath()), w, h, pix,
+        captureFormat == 0, gopts.scrshot_compression);
+
+    if (!panel->capture_burst) {
+        wxString msg;
+        msg.Printf(_("Saving snapshot %s"), fn.GetFullPath().wc_str());
+        systemScreenMessage(msg);
+    }
 }
 
 void systemSaveOldest()
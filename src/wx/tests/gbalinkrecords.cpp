@@ -0,0 +1,105 @@
+#include "../../gba/GBALinkRecords.h"
+
+#include "tests.hpp"
+
+// what one side has queued arrives at the other, n bytes at a time
+static void deliver(LinkPeer& from, LinkPeer& to, size_t n = LINK_RECORD_SIZE)
+{
+    while (!from.out.empty()) {
+        size_t chunk = from.out.size() < n ? from.out.size() : n;
+        to.in.insert(to.in.end(), from.out.begin(), from.out.begin() + chunk);
+        from.out.erase(from.out.begin(), from.out.begin() + chunk);
+        LinkParse(to);
+    }
+}
+
+TEST_CASE("link records survive being split anywhere") {
+    LinkPeer slave, master;
+    LinkPeerReset(slave);
+    LinkPeerReset(master);
+
+    const uint16_t values[4] = { 0x1234, 0xfedc, 0x0001, 0x8000 };
+    LinkQueue(master, LINK_REC_TRANSFER, 0x123456789aULL, 3, values);
+    LinkQueue(master, LINK_REC_SYNC, 0x123456789bULL);
+
+    deliver(master, slave, 7);
+
+    REQUIRE(slave.in.empty());
+    REQUIRE(slave.records.size() == 1);
+    REQUIRE(slave.tick == 0x123456789bULL);
+
+    const LinkRecord& rec = slave.records.front();
+    REQUIRE(rec.type == LINK_REC_TRANSFER);
+    REQUIRE(rec.speed == 3);
+    REQUIRE(rec.tick == 0x123456789aULL);
+    for (int i = 0; i < 4; i++)
+        REQUIRE(rec.values[i] == values[i]);
+}
+
+TEST_CASE("the master stamps transfers with what the slave last reported") {
+    // master keeps the slave as peer, the slave keeps the master
+    LinkPeer slave, master;
+    LinkPeerReset(slave);
+    LinkPeerReset(master);
+
+    const uint16_t before[4] = { 0x0011 };
+    const uint16_t after[4] = { 0x0022 };
+    LinkQueue(master, LINK_REC_DATA, 100, 0, before);
+    LinkQueue(master, LINK_REC_DATA, 300, 0, after);
+    LinkQueue(master, LINK_REC_SYNC, 300);
+    deliver(master, slave);
+
+    // transfers at 200 and 400 while the slave is behind neither
+    uint16_t cable[4] = { 0xaaaa, LinkDataAt(slave, 200), 0xffff, 0xffff };
+    REQUIRE(cable[1] == 0x0011);
+    LinkQueue(slave, LINK_REC_TRANSFER, 200, 1, cable);
+
+    cable[1] = LinkDataAt(slave, 400);
+    REQUIRE(cable[1] == 0x0022);
+    LinkQueue(slave, LINK_REC_TRANSFER, 400, 1, cable);
+    LinkQueue(slave, LINK_REC_SYNC, 450);
+    deliver(slave, master);
+
+    // the slave plays each back once it reaches its tick
+    LinkRecord transfer;
+    REQUIRE_FALSE(LinkTakeTransfer(master, 199, transfer));
+    REQUIRE(LinkTakeTransfer(master, 205, transfer));
+    REQUIRE(transfer.tick == 200);
+    REQUIRE(transfer.values[0] == 0xaaaa);
+    REQUIRE(transfer.values[1] == 0x0011);
+    REQUIRE_FALSE(LinkTakeTransfer(master, 399, transfer));
+    REQUIRE(LinkTakeTransfer(master, 400, transfer));
+    REQUIRE(transfer.values[1] == 0x0022);
+    REQUIRE(master.tick == 450);
+}
+
+TEST_CASE("records sent before CLOSE are still played") {
+    LinkPeer slave, master;
+    LinkPeerReset(slave);
+    LinkPeerReset(master);
+
+    const uint16_t values[4] = { 1, 2, 3, 4 };
+    LinkQueue(slave, LINK_REC_TRANSFER, 1000, 0, values);
+    LinkQueue(slave, LINK_REC_CLOSE, 1100);
+    LinkQueue(slave, LINK_REC_SYNC, 5000); // never sent in practice
+    deliver(slave, master, 13);
+
+    REQUIRE(master.closing);
+    REQUIRE(master.tick == 1100);
+    REQUIRE(master.in.empty());
+    REQUIRE_FALSE(LinkPeerDone(master, 900));
+
+    // not done until the transfer is played, and the close tick reached
+    REQUIRE_FALSE(LinkPeerDone(master, 1100));
+    LinkRecord transfer;
+    REQUIRE(LinkTakeTransfer(master, 1000, transfer));
+    REQUIRE_FALSE(LinkPeerDone(master, 1099));
+    REQUIRE(LinkPeerDone(master, 1100));
+
+    // a closing slave's unused SIODATA8 reports don't hold the master up
+    const uint16_t data[4] = { 0x55 };
+    LinkQueue(master, LINK_REC_DATA, 1050, 0, data);
+    LinkQueue(master, LINK_REC_CLOSE, 1060);
+    deliver(master, slave);
+    REQUIRE(LinkPeerDone(slave, 1060));
+}
@@ -26,6 +26,8 @@ void Viewer::CloseDlg(wxCloseEvent& ev)
 Viewer::Viewer(const wxString& name)
     : wxDialog()
     , auto_update(false)
+    , watch_pos(0)
+    , watch_diff(false)
 {
     dname = name;
     MainFrame* f = wxGetApp().frame;
@@ -53,6 +55,32 @@ void Viewer::ActiveCtrl(wxCommandEvent& ev)
     }
 }
 
+void Viewer::Watch(const void* data, size_t len)
+{
+    if (!data)
+        return;
+
+    if (watch_pos + len > watched.size()) {
+        watched.resize(watch_pos + len);
+        watch_diff = true;
+    } else if (!watch_diff && memcmp(&watched[watch_pos], data, len))
+        watch_diff = true;
+
+    if (watch_diff)
+        memcpy(&watched[watch_pos], data, len);
+
+    watch_pos += len;
+}
+
+bool Viewer::WatchChanged()
+{
+    bool changed = watch_diff || watch_pos != watched.size();
+    watched.resize(watch_pos);
+    watch_pos = 0;
+    watch_diff = false;
+    return changed;
+}
+
 BEGIN_EVENT_TABLE(Viewer, wxDialog)
 EVT_CLOSE(Viewer::CloseDlg)
 EVT_CHECKBOX(XRCID("AutoUpdate"), Viewer::SetAutoUpdate)
@@ -63,12 +91,25 @@ EVT_SCROLL(Viewer::ActiveCtrlScr)
 END_EVENT_TABLE()
 }
 
+// auto-updating viewers are refreshed at most this often (ms)
+#define VIEWER_UPDATE_INTERVAL 50
+
 void MainFrame::UpdateViewers()
 {
+    if (popups.empty())
+        return;
+
+    wxLongLong now = wxGetLocalTimeMillis();
+
+    if (now - viewers_updated < VIEWER_UPDATE_INTERVAL && now >= viewers_updated)
+        return;
+
+    viewers_updated = now;
+
     for (dialog_list_t::iterator i = popups.begin(); i != popups.end(); ++i) {
         Viewers::Viewer* d = static_cast<Viewers::Viewer*>(*i);
 
-        if (d->auto_update)
+        if (d->auto_update && d->SourceChanged())
             d->Update();
     }
 }
@@ -15,13 +15,15 @@
 #include <wx/checkbox.h>
 
 #include <stdint.h> // for uint32_t
+#include <vector>
 
 // avoid exporting too much stuff
 namespace Viewers {
 // common to all viewers:
 //   - track in MainFrame::popups
 //   - wxID_CLOSE button closes window
-//   - AutoUpdate checkbox toggles calling Update() every screen refresh
+//   - AutoUpdate checkbox toggles calling Update() on screen refreshes
+//     where SourceChanged() says there is something new to show
 class Viewer : public wxDialog {
 public:
     void CloseDlg(wxCloseEvent& ev);
@@ -31,6 +33,12 @@ public:
     }
     virtual void Update() = 0;
     bool auto_update;
+    // viewers that can tell cheaply whether their source data changed
+    // override this with a few Watch() calls
+    virtual bool SourceChanged()
+    {
+        return true;
+    }
 
     // A lot of viewers have GUI elements to set parameters.  Almost all
     // of them just read back the value and update the display.  This
@@ -52,6 +60,17 @@ protected:
         auto_update = ev.IsChecked();
     }
 
+    // compare a block of emulated memory with its copy from the last
+    // check; WatchChanged() reports whether any block watched since the
+    // previous call differed
+    void Watch(const void* data, size_t len);
+    bool WatchChanged();
+
+private:
+    std::vector<uint8_t> watched;
+    size_t watch_pos;
+    bool watch_diff;
+
     DECLARE_EVENT_TABLE()
 };
 
@@ -337,6 +337,9 @@ bool wxvbamApp::OnInit()
     }
 
     pending_optset.clear();
+    wxFileName archive_cache(GetDataDir(), wxT("archive-cache"));
+    wxFileName::Mkdir(GetDataDir(), 0777, wxPATH_MKDIR_FULL);
+    utilSetArchiveCacheDir(UTF8(archive_cache.GetFullPath()));
     wxFileName vba_over(GetConfigurationPath(), wxT("vba-over.ini"));
     wxFileName rdb(GetConfigurationPath(), wxT("Nintendo - Game Boy Advance*.dat"));
     wxFileName scene_rdb(GetConfigurationPath(), wxT("Nintendo - Game Boy Advance (Scene)*.dat"));
@@ -16,6 +16,8 @@
 #include "wx/sdljoy.h"
 #include "wx/wxmisc.h"
 #include "wxhead.h"
+#include "../common/BatteryJournal.h"
+#include "../common/ScreenshotWriter.h"
 #ifndef NO_FFMPEG
 #include "../common/ffmpeg.h"
 #endif
@@ -305,8 +307,10 @@ public:
     // to be cleared between games
     void ResetCheatSearch();
 
-    // call this to update the viewers once a frame:
+    // call this to update the viewers once a frame; they are refreshed
+    // at a capped rate, and only when what they show changed:
     void UpdateViewers();
+    wxLongLong viewers_updated;
 
     virtual bool MenusOpened() { return menus_opened; }
 
@@ -652,7 +656,15 @@ protected:
     recording::MediaRecorder snd_rec, vid_rec;
 #endif
 
+    // writes battery changes off the emulation thread
+    BatteryJournal battery_journal;
+
 public:
+    // screen captures are encoded and saved off the emulation thread
+    ScreenshotWriter screenshot_writer;
+    // frames left to capture in a capture burst
+    int capture_burst;
+
     void ShowPointer();
     void HidePointer();
     void HideMenuBar();
@@ -796,6 +808,8 @@ void systemStartGameRecording(const wxString& fname);
 void systemStopGameRecording();
 void systemStartGamePlayback(const wxString& fname);
 void systemStopGamePlayback();
+void systemSeekGamePlayback(uint32_t frame);
+void systemUpdateGameRecording();
 
 // true if turbo mode (like pressing turbo button constantly)
 extern bool turbo;